@@ -0,0 +1,73 @@
+#pragma once
+
+#include <algorithm>
+#include <chrono>
+#include <stdint.h>
+#include <stdio.h>
+#include <string>
+#include <vector>
+
+struct BenchOptions {
+  int iterations = 5;  // timed runs per measurement, median is reported
+  double scale = 1.0;  // corpus size multiplier
+  std::string filter;  // run only measurements whose name contains this
+};
+
+struct BenchResult {
+  std::string name;
+  double value;
+  const char *unit;
+};
+
+class BenchReport {
+public:
+  explicit BenchReport(const BenchOptions &o) : opt(o) {}
+
+  bool enabled(const std::string &name) const { return opt.filter.empty() || name.find(opt.filter) != std::string::npos; }
+  void add(const std::string &name, double value, const char *unit);
+  void writeJson(FILE *f) const;
+
+  const BenchOptions &opt;
+  std::vector<BenchResult> results;
+};
+
+// deterministic generator, so corpora are identical across runs and versions
+struct BenchRng {
+  uint32_t state;
+
+  explicit BenchRng(uint32_t seed) : state(seed) {}
+  uint32_t next() {
+    state = state * 1664525u + 1013904223u;
+    return state >> 8;
+  }
+  int range(int n) { return int(next() % uint32_t(n)); }
+  float uniform(float lo, float hi) { return lo + (hi - lo) * float(next() & 0xFFFF) / 65535.f; }
+};
+
+inline double bench_now_ms() {
+  return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+// corpus size or operation count multiplied by --scale
+inline int bench_scaled(const BenchOptions &opt, int n) { return std::max(1, int(n * opt.scale)); }
+
+// returns median time of fn() in milliseconds
+template <typename F>
+double bench_median_ms(int iterations, F &&fn) {
+  std::vector<double> t;
+  for (int i = 0; i < iterations; ++i) {
+    double t0 = bench_now_ms();
+    fn();
+    t.push_back(bench_now_ms() - t0);
+  }
+  std::sort(t.begin(), t.end());
+  return t[t.size() / 2];
+}
+
+// current resident set size of the process, in KB (0 when unknown)
+size_t bench_rss_kb();
+// resident memory taken by loading BLK file into DataBlock in separate process, in KB (0 when unknown)
+size_t bench_load_rss_kb(const char *blk_path);
+
+void bench_datablock(BenchReport &report);
+void bench_bitstream(BenchReport &report);
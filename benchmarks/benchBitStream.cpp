@@ -0,0 +1,768 @@
+#include "bench.h"
+#include <bitstream/bitstream.h>
+#include <bitstream/bitstreamMath.h>
+#include <bitstream/bitstreamReader.h>
+#include <bitstream/bitstreamSegmented.h>
+#include <functional>
+#include <math.h>
+#include <string.h>
+#include <type_traits>
+
+// Each case encodes the same pre-generated values into one stream, then decodes them and checks them against the source.
+// Writes reuse the stream buffer, so they measure encoding and not reallocation.
+struct StreamCase {
+  const char *name;
+  int ops; // write or read calls per pass (entities for packet mixes)
+  std::function<void(danet::BitStream &)> write;
+  std::function<int(const danet::BitStream &)> read; // returns number of failed or mismatching reads
+};
+
+static uint32_t next_word(BenchRng &rng) { return rng.next() ^ (rng.next() << 24); }
+
+static StreamCase words_case(const char *name, int n, BenchRng &rng, uint32_t pad_bits) {
+  std::vector<uint32_t> words(n);
+  for (uint32_t &w : words)
+    w = next_word(rng);
+  return {name, n,
+          [=](danet::BitStream &bs) {
+            uint8_t pad = 0;
+            bs.WriteBits(&pad, pad_bits);
+            for (uint32_t w : words)
+              bs.Write(w);
+          },
+          [=](const danet::BitStream &bs) {
+            uint8_t pad = 0;
+            int err = !bs.ReadBits(&pad, pad_bits);
+            for (uint32_t w : words) {
+              uint32_t v = 0;
+              err += !bs.Read(v) || v != w;
+            }
+            return err;
+          }};
+}
+
+// fields of random width 1..32, passed as little-endian bytes the way game code does it today
+static StreamCase mixed_width_case(int n, BenchRng &rng) {
+  std::vector<std::pair<uint32_t, uint8_t>> fields(n);
+  for (auto &f : fields) {
+    f.second = uint8_t(1 + rng.range(32));
+    f.first = next_word(rng) >> (32 - f.second);
+  }
+  return {"mixed_width", n,
+          [=](danet::BitStream &bs) {
+            for (auto &f : fields)
+              bs.WriteBits((const uint8_t *)&f.first, f.second);
+          },
+          [=](const danet::BitStream &bs) {
+            int err = 0;
+            for (auto &f : fields) {
+              uint32_t v = 0;
+              err += !bs.ReadBits((uint8_t *)&v, f.second) || v != f.first;
+            }
+            return err;
+          }};
+}
+
+// same fields as mixed_width, through integer-valued API
+static StreamCase bits_value_case(int n, BenchRng &rng) {
+  std::vector<std::pair<uint32_t, uint8_t>> fields(n);
+  for (auto &f : fields) {
+    f.second = uint8_t(1 + rng.range(32));
+    f.first = next_word(rng) >> (32 - f.second);
+  }
+  return {"bits_value", n,
+          [=](danet::BitStream &bs) {
+            for (auto &f : fields)
+              bs.WriteBitsValue(f.first, f.second);
+          },
+          [=](const danet::BitStream &bs) {
+            int err = 0;
+            for (auto &f : fields) {
+              uint32_t v = 0;
+              err += !bs.ReadBitsValue(v, f.second) || v != f.first;
+            }
+            return err;
+          }};
+}
+
+static StreamCase array_case(int n, BenchRng &rng) {
+  const int CHUNK = 256;
+  int chunks = std::max(1, n * 4 / CHUNK);
+  std::vector<uint8_t> bytes(size_t(chunks) * CHUNK);
+  for (uint8_t &b : bytes)
+    b = uint8_t(rng.next());
+  return {"array_unaligned", chunks,
+          [=](danet::BitStream &bs) {
+            bs.Write1();
+            bs.Write0();
+            bs.Write1();
+            for (int i = 0; i < chunks; ++i)
+              bs.WriteArray(bytes.data() + i * CHUNK, CHUNK);
+          },
+          [=](const danet::BitStream &bs) {
+            uint8_t buf[CHUNK];
+            int err = !(bs.ReadBit() && !bs.ReadBit() && bs.ReadBit());
+            for (int i = 0; i < chunks; ++i)
+              err += !bs.ReadArray(buf, CHUNK) || memcmp(buf, bytes.data() + i * CHUNK, CHUNK) != 0;
+            return err;
+          }};
+}
+
+// value bit lengths are uniform, so every VLQ byte count is covered
+template <typename T>
+static std::vector<T> make_compressed_values(int n, BenchRng &rng) {
+  std::vector<T> values(n);
+  for (T &v : values) {
+    int len = 1 + rng.range(int(sizeof(T) * 8) - (std::is_signed_v<T> ? 1 : 0));
+    if constexpr (sizeof(T) > 4)
+      v = T(((uint64_t(next_word(rng)) << 32) | next_word(rng)) >> (64 - len));
+    else
+      v = T(next_word(rng) >> (32 - len));
+    if constexpr (std::is_signed_v<T>)
+      if (rng.range(2))
+        v = T(-v);
+  }
+  return values;
+}
+
+template <typename T>
+static StreamCase compressed_case(const char *name, int n, BenchRng &rng) {
+  std::vector<T> values = make_compressed_values<T>(n, rng);
+  return {name, n,
+          [=](danet::BitStream &bs) {
+            for (T v : values)
+              bs.WriteCompressed(v);
+          },
+          [=](const danet::BitStream &bs) {
+            int err = 0;
+            for (T v : values) {
+              T r = 0;
+              err += !bs.ReadCompressed(r) || r != v;
+            }
+            return err;
+          }};
+}
+
+template <typename T>
+static StreamCase compressed_array_case(const char *name, int n, BenchRng &rng) {
+  std::vector<T> values = make_compressed_values<T>(n, rng);
+  return {name, n,
+          [=](danet::BitStream &bs) { bs.WriteCompressedArray(values.data(), uint32_t(values.size())); },
+          [=, out = std::vector<T>(values.size())](const danet::BitStream &bs) mutable {
+            if (!bs.ReadCompressedArray(out.data(), uint32_t(out.size())))
+              return int(out.size());
+            int err = 0;
+            for (size_t i = 0; i < out.size(); ++i)
+              err += out[i] != values[i];
+            return err;
+          }};
+}
+
+static StreamCase bools_case(int n, BenchRng &rng) {
+  std::vector<uint8_t> flags(n);
+  for (uint8_t &f : flags)
+    f = rng.range(4) == 0; // sparse, like dirty flags
+  return {"bools", n,
+          [=](danet::BitStream &bs) {
+            for (uint8_t f : flags)
+              bs.Write(f != 0);
+          },
+          [=](const danet::BitStream &bs) {
+            int err = 0;
+            for (uint8_t f : flags) {
+              bool v = false;
+              err += !bs.Read(v) || v != (f != 0);
+            }
+            return err;
+          }};
+}
+
+static StreamCase strings_case(int n, BenchRng &rng) {
+  std::vector<std::string> strs(std::max(1, n / 8));
+  for (std::string &s : strs)
+    for (int i = 0, len = rng.range(48); i < len; ++i)
+      s += char('a' + rng.range(26));
+  return {"strings", int(strs.size()),
+          [=](danet::BitStream &bs) {
+            bs.Write1(); // strings are usually not byte aligned in packets
+            for (const std::string &s : strs)
+              bs.Write(s);
+          },
+          [=](const danet::BitStream &bs) {
+            std::string tmp;
+            int err = !bs.ReadBit();
+            for (const std::string &s : strs)
+              err += !bs.Read(tmp) || tmp != s;
+            return err;
+          }};
+}
+
+// Byte aligned strings (e.g. message fields), copied out or only compared through views into stream
+static StreamCase aligned_strings_case(int n, BenchRng &rng, bool view) {
+  std::vector<std::string> strs(std::max(1, n / 8));
+  for (std::string &s : strs)
+    for (int i = 0, len = rng.range(48); i < len; ++i)
+      s += char('a' + rng.range(26));
+  auto write = [=](danet::BitStream &bs) {
+    for (const std::string &s : strs)
+      bs.Write(s);
+  };
+  if (view)
+    return {"strings_view", int(strs.size()), write, [=](const danet::BitStream &bs) {
+              eastl::string_view tmp;
+              int err = 0;
+              for (const std::string &s : strs)
+                err += !bs.ReadStringView(tmp) || tmp != eastl::string_view(s.data(), s.size());
+              return err;
+            }};
+  return {"strings_aligned", int(strs.size()), write, [=](const danet::BitStream &bs) {
+            std::string tmp;
+            int err = 0;
+            for (const std::string &s : strs)
+              err += !bs.Read(tmp) || tmp != s;
+            return err;
+          }};
+}
+
+// Strings over former 64K limit (script sources, JSON blobs), one of them not byte aligned
+static StreamCase large_strings_case(int n, BenchRng &rng) {
+  std::vector<std::string> strs(std::max(2, n / 65536));
+  for (std::string &s : strs) {
+    s.resize(65536 + rng.range(256 << 10));
+    for (char &c : s)
+      c = char(' ' + rng.range(95));
+  }
+  return {"strings_large", int(strs.size()),
+          [=](danet::BitStream &bs) {
+            for (size_t i = 0; i < strs.size(); ++i) {
+              if (i == 1)
+                bs.Write1();
+              bs.Write(strs[i]);
+            }
+          },
+          [=, tmp = std::string()](const danet::BitStream &bs) mutable {
+            int err = 0;
+            for (size_t i = 0; i < strs.size(); ++i) {
+              if (i == 1)
+                err += !bs.ReadBit();
+              err += !bs.Read(tmp) || tmp != strs[i];
+            }
+            return err;
+          }};
+}
+
+static StreamCase containers_case(int n, BenchRng &rng) {
+  std::vector<std::vector<uint16_t>> conts(std::max(1, n / 16));
+  for (auto &c : conts)
+    for (int i = 0, sz = rng.range(24); i < sz; ++i)
+      c.push_back(uint16_t(rng.next()));
+  return {"containers", int(conts.size()),
+          [=](danet::BitStream &bs) {
+            bs.Write1();
+            for (auto &c : conts)
+              bs.Write(c);
+          },
+          [=](const danet::BitStream &bs) {
+            std::vector<uint16_t> tmp;
+            int err = !bs.ReadBit();
+            for (auto &c : conts)
+              err += !bs.Read(tmp) || tmp != c;
+            return err;
+          }};
+}
+
+// Few large arrays, as in snapshots of whole component tables
+static StreamCase large_containers_case(int n, BenchRng &rng) {
+  std::vector<std::vector<uint32_t>> conts(std::max(1, n / 4096));
+  for (auto &c : conts)
+    for (int i = 0; i < 4096; ++i)
+      c.push_back(next_word(rng));
+  return {"containers_large", int(conts.size()),
+          [=](danet::BitStream &bs) {
+            bs.Write1();
+            for (auto &c : conts)
+              bs.Write(c);
+          },
+          [=, tmp = std::vector<uint32_t>()](const danet::BitStream &bs) mutable {
+            int err = !bs.ReadBit();
+            for (auto &c : conts)
+              err += !bs.Read(tmp) || tmp != c;
+            return err;
+          }};
+}
+
+static StreamCase nested_case(int n, BenchRng &rng) {
+  std::vector<danet::BitStream> subs(std::max(1, n / 32));
+  for (danet::BitStream &sub : subs)
+    for (int i = 0, cnt = 1 + rng.range(16); i < cnt; ++i) {
+      uint32_t v = next_word(rng);
+      sub.WriteBits((const uint8_t *)&v, 1 + rng.range(32));
+    }
+  return {"nested", int(subs.size()),
+          [=](danet::BitStream &bs) {
+            for (const danet::BitStream &sub : subs) {
+              bs.Write1();
+              bs.Write(sub);
+            }
+          },
+          [=](const danet::BitStream &bs) {
+            danet::BitStream tmp;
+            int err = 0;
+            for (const danet::BitStream &sub : subs) {
+              tmp.Reset();
+              err += !bs.ReadBit() || !bs.Read(tmp) || tmp.GetNumberOfBitsUsed() != sub.GetNumberOfBitsUsed() ||
+                     memcmp(tmp.GetData(), sub.GetData(), sub.GetNumberOfBytesUsed()) != 0;
+            }
+            return err;
+          }};
+}
+
+// Typical replication snapshot: sorted entity ids as deltas, dirty flags, then only dirty components.
+// Quantized values are passed as little-endian bytes, as game code does today.
+struct Entity {
+  uint32_t id;
+  bool posDirty, rotDirty, stateDirty, nameDirty;
+  uint32_t pos[3]; // 20 bits each
+  uint16_t rot[3];
+  uint8_t health;
+  uint8_t state; // 5 bits
+  std::string name;
+};
+
+static void write_entity(danet::BitStream &bs, const Entity &e, uint32_t prev_id) {
+  bs.WriteCompressed(uint32_t(e.id - prev_id));
+  bs.Write(e.posDirty);
+  bs.Write(e.rotDirty);
+  bs.Write(e.stateDirty);
+  bs.Write(e.nameDirty);
+  if (e.posDirty)
+    for (uint32_t p : e.pos)
+      bs.WriteBits((const uint8_t *)&p, 20);
+  if (e.rotDirty)
+    for (uint16_t r : e.rot)
+      bs.Write(r);
+  if (e.stateDirty) {
+    bs.Write(e.health);
+    bs.WriteBits(&e.state, 5);
+  }
+  if (e.nameDirty)
+    bs.Write(e.name);
+}
+
+static bool read_entity(const danet::BitStream &bs, Entity &e, uint32_t prev_id) {
+  uint32_t delta = 0;
+  if (!bs.ReadCompressed(delta) || !bs.Read(e.posDirty) || !bs.Read(e.rotDirty) || !bs.Read(e.stateDirty) ||
+      !bs.Read(e.nameDirty))
+    return false;
+  e.id = prev_id + delta;
+  if (e.posDirty)
+    for (uint32_t &p : e.pos)
+      if (!bs.ReadBits((uint8_t *)&(p = 0), 20))
+        return false;
+  if (e.rotDirty)
+    for (uint16_t &r : e.rot)
+      if (!bs.Read(r))
+        return false;
+  if (e.stateDirty && (!bs.Read(e.health) || !bs.ReadBits(&(e.state = 0), 5)))
+    return false;
+  return !e.nameDirty || bs.Read(e.name);
+}
+
+// same as read_entity(), failure is checked by caller once per packet
+static void read_entity_sticky(danet::StickyReader &r, Entity &e, uint32_t prev_id) {
+  uint32_t delta = 0;
+  r.ReadCompressed(delta);
+  r.Read(e.posDirty);
+  r.Read(e.rotDirty);
+  r.Read(e.stateDirty);
+  r.Read(e.nameDirty);
+  e.id = prev_id + delta;
+  if (e.posDirty)
+    for (uint32_t &p : e.pos)
+      r.ReadBits((uint8_t *)&(p = 0), 20);
+  if (e.rotDirty)
+    for (uint16_t &v : e.rot)
+      r.Read(v);
+  if (e.stateDirty) {
+    r.Read(e.health);
+    r.ReadBits(&(e.state = 0), 5);
+  }
+  if (e.nameDirty)
+    r.Read(e.name);
+}
+
+static bool same_entity(const Entity &a, const Entity &b) {
+  return a.id == b.id && a.posDirty == b.posDirty && a.rotDirty == b.rotDirty && a.stateDirty == b.stateDirty &&
+         a.nameDirty == b.nameDirty && (!a.posDirty || memcmp(a.pos, b.pos, sizeof(a.pos)) == 0) &&
+         (!a.rotDirty || memcmp(a.rot, b.rot, sizeof(a.rot)) == 0) &&
+         (!a.stateDirty || (a.health == b.health && a.state == b.state)) && (!a.nameDirty || a.name == b.name);
+}
+
+static std::vector<Entity> make_entities(int n, BenchRng &rng) {
+  std::vector<Entity> ents(std::max(1, n / 8));
+  uint32_t id = 0;
+  for (Entity &e : ents) {
+    e.id = id += 1 + rng.range(rng.range(16) ? 4 : 1000);
+    e.posDirty = rng.range(10) < 8;
+    e.rotDirty = rng.range(2) == 0;
+    e.stateDirty = rng.range(5) == 0;
+    e.nameDirty = rng.range(50) == 0;
+    for (uint32_t &p : e.pos)
+      p = rng.next() & 0xFFFFF;
+    for (uint16_t &r : e.rot)
+      r = uint16_t(rng.next());
+    e.health = uint8_t(rng.next());
+    e.state = uint8_t(rng.range(32));
+    for (int i = 0, len = 4 + rng.range(12); i < len; ++i)
+      e.name += char('a' + rng.range(26));
+  }
+  return ents;
+}
+
+static void write_entities(danet::BitStream &bs, const std::vector<Entity> &ents) {
+  uint32_t prev = 0;
+  for (const Entity &e : ents) {
+    write_entity(bs, e, prev);
+    prev = e.id;
+  }
+}
+
+static StreamCase packet_mix_case(int n, BenchRng &rng) {
+  std::vector<Entity> ents = make_entities(n, rng);
+  return {"packet_mix", int(ents.size()), [=](danet::BitStream &bs) { write_entities(bs, ents); },
+          [=](const danet::BitStream &bs) {
+            Entity tmp;
+            uint32_t prev = 0;
+            int err = 0;
+            for (const Entity &e : ents) {
+              if (!read_entity(bs, tmp, prev))
+                return err + 1; // stream is out of sync after failed read
+              err += !same_entity(tmp, e);
+              prev = e.id;
+            }
+            return err;
+          }};
+}
+
+// Same packets decoded by StickyReader, which is checked once per packet instead of every field
+static StreamCase packet_mix_sticky_case(int n, BenchRng &rng) {
+  std::vector<Entity> ents = make_entities(n, rng);
+  return {"packet_mix_sticky", int(ents.size()), [=](danet::BitStream &bs) { write_entities(bs, ents); },
+          [=](const danet::BitStream &bs) {
+            danet::StickyReader r(bs);
+            Entity tmp;
+            uint32_t prev = 0;
+            int err = 0;
+            for (const Entity &e : ents) {
+              read_entity_sticky(r, tmp, prev);
+              err += !same_entity(tmp, e);
+              prev = e.id;
+            }
+            return r.IsOk() ? err : err + 1;
+          }};
+}
+
+// Entity state with floats, sent as raw values or through ranged/quantized/half writers
+struct EntityState {
+  float pos[3];    // within +-4096 map bounds
+  float angles[3]; // -pi..pi
+  int health;      // 0..1000
+  float speed;
+};
+
+static std::vector<EntityState> make_states(int n, BenchRng &rng) {
+  std::vector<EntityState> states(std::max(1, n / 8));
+  for (EntityState &st : states) {
+    for (float &p : st.pos)
+      p = rng.uniform(-4096.f, 4096.f);
+    for (float &a : st.angles)
+      a = rng.uniform(-3.14159f, 3.14159f);
+    st.health = rng.range(1001);
+    st.speed = rng.uniform(0.f, 100.f);
+  }
+  return states;
+}
+
+static StreamCase state_raw_case(int n, BenchRng &rng) {
+  std::vector<EntityState> states = make_states(n, rng);
+  return {"state_raw", int(states.size()),
+          [=](danet::BitStream &bs) {
+            for (const EntityState &st : states) {
+              bs.Write(st.pos);
+              bs.Write(st.angles);
+              bs.Write(int16_t(st.health));
+              bs.Write(st.speed);
+            }
+          },
+          [=](const danet::BitStream &bs) {
+            int err = 0;
+            for (const EntityState &st : states) {
+              EntityState r;
+              int16_t health = 0;
+              err += !bs.Read(r.pos) || !bs.Read(r.angles) || !bs.Read(health) || !bs.Read(r.speed) ||
+                     memcmp(r.pos, st.pos, sizeof(r.pos)) != 0 || memcmp(r.angles, st.angles, sizeof(r.angles)) != 0 ||
+                     health != st.health || r.speed != st.speed;
+            }
+            return err;
+          }};
+}
+
+static StreamCase state_quantized_case(int n, BenchRng &rng) {
+  std::vector<EntityState> states = make_states(n, rng);
+  const uint32_t POS_BITS = 20, ANGLE_BITS = 12;
+  return {"state_quantized", int(states.size()),
+          [=](danet::BitStream &bs) {
+            for (const EntityState &st : states) {
+              for (float p : st.pos)
+                bs.WriteQuantized(p, -4096.f, 4096.f, POS_BITS);
+              for (float a : st.angles)
+                bs.WriteQuantized(a, -3.14159f, 3.14159f, ANGLE_BITS);
+              bs.WriteRanged(st.health, 0, 1000);
+              bs.WriteHalf(st.speed);
+            }
+          },
+          [=](const danet::BitStream &bs) {
+            const float posErr = 8192.f / ((2 << POS_BITS) - 2) * 1.001f, angleErr = 6.28318f / ((2 << ANGLE_BITS) - 2) * 1.001f;
+            int err = 0;
+            for (const EntityState &st : states) {
+              EntityState r;
+              for (int i = 0; i < 3; ++i)
+                err += !bs.ReadQuantized(r.pos[i], -4096.f, 4096.f, POS_BITS) || fabsf(r.pos[i] - st.pos[i]) > posErr;
+              for (int i = 0; i < 3; ++i)
+                err += !bs.ReadQuantized(r.angles[i], -3.14159f, 3.14159f, ANGLE_BITS) ||
+                       fabsf(r.angles[i] - st.angles[i]) > angleErr;
+              err += !bs.ReadRanged(r.health, 0, 1000) || r.health != st.health;
+              err += !bs.ReadHalf(r.speed) || fabsf(r.speed - st.speed) > st.speed / 2048;
+            }
+            return err;
+          }};
+}
+
+// Same quantized state, its size is checked once per entity by ValidatedReader instead of every field
+static StreamCase state_validated_case(int n, BenchRng &rng) {
+  std::vector<EntityState> states = make_states(n, rng);
+  const uint32_t POS_BITS = 20, ANGLE_BITS = 12, STATE_BITS = 3 * POS_BITS + 3 * ANGLE_BITS + 10 + 16;
+  return {"state_validated", int(states.size()),
+          [=](danet::BitStream &bs) {
+            for (const EntityState &st : states) {
+              for (float p : st.pos)
+                bs.WriteQuantized(p, -4096.f, 4096.f, POS_BITS);
+              for (float a : st.angles)
+                bs.WriteQuantized(a, -3.14159f, 3.14159f, ANGLE_BITS);
+              bs.WriteRanged(st.health, 0, 1000);
+              bs.WriteHalf(st.speed);
+            }
+          },
+          [=](const danet::BitStream &bs) {
+            const float posErr = 8192.f / ((2 << POS_BITS) - 2) * 1.001f, angleErr = 6.28318f / ((2 << ANGLE_BITS) - 2) * 1.001f;
+            int err = 0;
+            for (const EntityState &st : states) {
+              danet::ValidatedReader r(bs, STATE_BITS);
+              if (!r)
+                return err + 1;
+              EntityState v;
+              for (float &p : v.pos)
+                r.ReadQuantized(p, -4096.f, 4096.f, POS_BITS);
+              for (float &a : v.angles)
+                r.ReadQuantized(a, -3.14159f, 3.14159f, ANGLE_BITS);
+              r.ReadRanged(v.health, 0, 1000);
+              r.ReadHalf(v.speed);
+              for (int i = 0; i < 3; ++i)
+                err += fabsf(v.pos[i] - st.pos[i]) > posErr || fabsf(v.angles[i] - st.angles[i]) > angleErr;
+              err += v.health != st.health || fabsf(v.speed - st.speed) > st.speed / 2048;
+            }
+            return err;
+          }};
+}
+
+// Rigid transforms (rotation + translation, some mirrored or scaled), sent raw or through bitstreamMath.h encodings
+static std::vector<TMatrix> make_transforms(int n, BenchRng &rng) {
+  std::vector<TMatrix> tms(std::max(1, n / 8));
+  for (size_t i = 0; i < tms.size(); ++i) {
+    Quat q = normalize(Quat(rng.uniform(-1, 1), rng.uniform(-1, 1), rng.uniform(-1, 1), rng.uniform(-1, 1)));
+    TMatrix &tm = tms[i];
+    tm = makeTM(q);
+    if (i % 16 == 0)
+      tm.setcol(0, tm.getcol(0) * -2.f);
+    tm.setcol(3, Point3(rng.uniform(-4096.f, 4096.f), rng.uniform(-100.f, 500.f), rng.uniform(-4096.f, 4096.f)));
+  }
+  return tms;
+}
+
+static StreamCase transforms_raw_case(int n, BenchRng &rng) {
+  std::vector<TMatrix> tms = make_transforms(n, rng);
+  return {"transforms_raw", int(tms.size()),
+          [=](danet::BitStream &bs) {
+            for (const TMatrix &tm : tms)
+              bs.Write(tm);
+          },
+          [=](const danet::BitStream &bs) {
+            int err = 0;
+            for (const TMatrix &tm : tms) {
+              TMatrix r;
+              err += !bs.Read(r) || memcmp(&r, &tm, sizeof(r)) != 0;
+            }
+            return err;
+          }};
+}
+
+static StreamCase transforms_compressed_case(int n, BenchRng &rng) {
+  std::vector<TMatrix> tms = make_transforms(n, rng);
+  const BBox3 bounds(Point3(-4096, -100, -4096), Point3(4096, 500, 4096));
+  const uint32_t ROT_BITS = 12, POS_BITS = 20;
+  return {"transforms_compressed", int(tms.size()),
+          [=](danet::BitStream &bs) {
+            for (const TMatrix &tm : tms)
+              bs.Write(danet::compressed_tm(tm, bounds, ROT_BITS, POS_BITS));
+          },
+          [=](const danet::BitStream &bs) {
+            int err = 0;
+            for (const TMatrix &tm : tms) {
+              TMatrix r;
+              err += !bs.Read(danet::compressed_tm(r, bounds, ROT_BITS, POS_BITS));
+              for (int i = 0; i < 3; ++i) // 0.06 degrees of rotation error is 0.001 of axis length
+                err += lengthSq(r.getcol(i) - tm.getcol(i)) > lengthSq(tm.getcol(i)) * 1e-6f;
+              err += length(r.getcol(3) - tm.getcol(3)) > 0.01f;
+            }
+            return err;
+          }};
+}
+
+
+static void report_pass(BenchReport &report, const std::string &name, double ms, int ops, size_t bytes) {
+  report.add(name, ms * 1e6 / ops, "ns/op");
+  report.add(name + "_bw", bytes / 1e9 / (ms / 1000.0), "GB/s");
+}
+
+static void run_case(BenchReport &report, const StreamCase &c) {
+  std::string prefix = std::string("bitstream/") + c.name + "/";
+  bool doWrite = report.enabled(prefix + "write"), doRead = report.enabled(prefix + "read");
+  bool doSize = report.enabled(prefix + "size");
+  if (!doWrite && !doRead && !doSize)
+    return;
+
+  danet::BitStream out;
+  c.write(out);
+  size_t bytes = out.GetNumberOfBytesUsed();
+  danet::BitStream in(out.GetData(), bytes, false);
+  if (doSize)
+    report.add(prefix + "size", double(bytes) / c.ops, "B/op");
+  if (int errors = c.read(in)) {
+    fprintf(stderr, "%s: %d values failed to round-trip\n", c.name, errors);
+    return;
+  }
+
+  if (doWrite) {
+    double ms = bench_median_ms(report.opt.iterations, [&] {
+      out.ResetWritePointer();
+      c.write(out);
+    });
+    report_pass(report, prefix + "write", ms, c.ops, bytes);
+  }
+  if (doRead) {
+    int errors = 0;
+    double ms = bench_median_ms(report.opt.iterations, [&] {
+      in.ResetReadPointer();
+      errors += c.read(in);
+    });
+    report_pass(report, prefix + "read", ms, c.ops, bytes);
+    if (errors)
+      fprintf(stderr, "%s: %d values failed to round-trip\n", c.name, errors);
+  }
+}
+
+// Large snapshot written to new stream every pass, so growth is measured: BitStream reallocates and copies,
+// SegmentedBitStream takes chunks from pool (warm after first pass)
+template <typename Stream>
+static void write_snapshot(Stream &bs, const std::vector<EntityState> &states) {
+  for (const EntityState &st : states) {
+    for (float p : st.pos)
+      bs.WriteQuantized(p, -4096.f, 4096.f, 20);
+    bs.Write(st.angles);
+    bs.WriteCompressed(uint32_t(st.health));
+    bs.Write(st.speed);
+  }
+}
+
+static void run_snapshot_growth(BenchReport &report, int n, BenchRng &rng) {
+  const std::string prefix = "bitstream/snapshot_growth/";
+  if (!report.enabled(prefix + "bitstream") && !report.enabled(prefix + "segmented"))
+    return;
+  std::vector<EntityState> states = make_states(n * 4, rng);
+  const int ops = int(states.size());
+
+  danet::BitStream ref;
+  write_snapshot(ref, states);
+  size_t bytes = ref.GetNumberOfBytesUsed();
+  report.add(prefix + "size", double(bytes), "B");
+
+  double ms = bench_median_ms(report.opt.iterations, [&] {
+    danet::BitStream bs;
+    write_snapshot(bs, states);
+  });
+  report_pass(report, prefix + "bitstream", ms, ops, bytes);
+
+  danet::BitStreamChunkPool pool;
+  Tab<dag::ConstSpan<uint8_t>> segments;
+  size_t segBytes = 0;
+  ms = bench_median_ms(report.opt.iterations, [&] {
+    danet::SegmentedBitStream bs(pool);
+    write_snapshot(bs, states);
+    bs.GetSegments(segments);
+    segBytes = 0;
+    for (auto &seg : segments)
+      segBytes += seg.size();
+  });
+  report_pass(report, prefix + "segmented", ms, ops, bytes);
+
+  ms = bench_median_ms(report.opt.iterations, [&] {
+    danet::SegmentedBitStream bs(pool);
+    write_snapshot(bs, states);
+    dag::ConstSpan<uint8_t> data = bs.Linearize();
+    if (data.size() != bytes || memcmp(data.data(), ref.GetData(), bytes) != 0)
+      segBytes = 0;
+  });
+  report_pass(report, prefix + "segmented_linear", ms, ops, bytes);
+  if (segBytes != bytes)
+    fprintf(stderr, "snapshot_growth: segmented stream differs from BitStream one\n");
+}
+
+void bench_bitstream(BenchReport &report) {
+  const int n = bench_scaled(report.opt, 1 << 20);
+  BenchRng rng(7);
+  fprintf(stderr, "bitstream/\n");
+
+  StreamCase cases[] = {
+    words_case("aligned", n, rng, 0),
+    words_case("unaligned", n, rng, 3),
+    mixed_width_case(n, rng),
+    array_case(n, rng),
+    compressed_case<uint16_t>("compressed_u16", n, rng),
+    compressed_case<uint32_t>("compressed_u32", n, rng),
+    compressed_case<int16_t>("compressed_i16", n, rng),
+    compressed_case<int32_t>("compressed_i32", n, rng),
+    bools_case(n, rng),
+    strings_case(n, rng),
+    containers_case(n, rng),
+    nested_case(n, rng),
+    packet_mix_case(n, rng),
+    bits_value_case(n, rng),
+    state_raw_case(n, rng),
+    state_quantized_case(n, rng),
+    transforms_raw_case(n, rng),
+    transforms_compressed_case(n, rng),
+    compressed_case<uint64_t>("compressed_u64", n, rng),
+    compressed_case<int64_t>("compressed_i64", n, rng),
+    compressed_array_case<uint32_t>("compressed_array_u32", n, rng),
+    compressed_array_case<int32_t>("compressed_array_i32", n, rng),
+    large_containers_case(n, rng),
+    aligned_strings_case(n, rng, false),
+    aligned_strings_case(n, rng, true),
+    large_strings_case(n, rng),
+    state_validated_case(n, rng),
+    packet_mix_sticky_case(n, rng),
+  };
+  for (const StreamCase &c : cases)
+    run_case(report, c);
+  run_snapshot_growth(report, n, rng);
+}
@@ -0,0 +1,266 @@
+#include "bench.h"
+#include <datablock/datablock.h>
+#include <ioSys/dag_memIo.h>
+#include <memory/dag_mem.h>
+#include <memory/dag_memStat.h>
+#include <filesystem>
+#include <string.h>
+
+// Synthetic BLK corpora, built as DataBlock trees with fixed seeds and saved to text,
+// so they are always valid and identical for a given scale.
+struct Corpus {
+  const char *name;
+  std::string text;                                          // main file
+  std::vector<std::pair<std::string, std::string>> includes; // file name, contents (stored next to main file)
+
+  size_t totalBytes() const {
+    size_t n = text.size();
+    for (auto &inc : includes)
+      n += inc.second.size();
+    return n;
+  }
+};
+
+static const int NAME_POOL = 64;
+
+static std::string to_text(const DataBlock &blk) {
+  DynamicMemGeneralSaveCB cb(tmpmem, 1 << 20);
+  blk.saveToTextStream(cb);
+  return std::string(cb.data(), cb.size());
+}
+
+static void add_mixed_params(DataBlock &blk, BenchRng &rng, int count) {
+  char name[32], value[32];
+  for (int i = 0; i < count; ++i) {
+    int kind = rng.range(5);
+    snprintf(name, sizeof(name), "%c%d", "irbpt"[kind], rng.range(NAME_POOL));
+    switch (kind) {
+      case 0: blk.addInt(name, int(rng.next()) - (1 << 23)); break;
+      case 1: blk.addReal(name, rng.uniform(-1000.f, 1000.f)); break;
+      case 2: blk.addBool(name, rng.range(2) != 0); break;
+      case 3: blk.addPoint3(name, Point3(rng.uniform(-1, 1), rng.uniform(-1, 1), rng.uniform(-1, 1))); break;
+      default: snprintf(value, sizeof(value), "v%u", rng.next()); blk.addStr(name, value); break;
+    }
+  }
+}
+
+static Corpus make_wide(const BenchOptions &opt) {
+  BenchRng rng(1);
+  DataBlock root;
+  add_mixed_params(root, rng, bench_scaled(opt, 20000));
+  char name[32];
+  for (int i = 0, n = bench_scaled(opt, 5000); i < n; ++i) {
+    snprintf(name, sizeof(name), "item%d", rng.range(NAME_POOL));
+    add_mixed_params(*root.addNewBlock(name), rng, 4);
+  }
+  return {"wide", to_text(root)};
+}
+
+static Corpus make_deep(const BenchOptions &opt) {
+  BenchRng rng(2);
+  DataBlock root;
+  char name[32];
+  for (int i = 0, n = bench_scaled(opt, 200); i < n; ++i) {
+    DataBlock *blk = root.addNewBlock("chain");
+    for (int d = 0; d < 48; ++d) {
+      snprintf(name, sizeof(name), "level%d", d % 8);
+      blk = blk->addNewBlock(name);
+      add_mixed_params(*blk, rng, 2);
+    }
+  }
+  return {"deep", to_text(root)};
+}
+
+static Corpus make_strings(const BenchOptions &opt) {
+  static const char chars[] = "abcdefghijklmnopqrstuvwxyz ABCDEFGHIJKLMNOPQRSTUVWXYZ 0123456789 .,:/-\"~\n\t";
+  BenchRng rng(3);
+  DataBlock root;
+  std::string s;
+  char name[32];
+  for (int i = 0, n = bench_scaled(opt, 4000); i < n; ++i) {
+    DataBlock *blk = root.addNewBlock("text");
+    for (int j = 0; j < 8; ++j) {
+      s.clear();
+      for (int k = 0, len = 8 + rng.range(192); k < len; ++k)
+        s += chars[rng.range(sizeof(chars) - 1)];
+      snprintf(name, sizeof(name), "s%d", rng.range(NAME_POOL));
+      blk->addStr(name, s.c_str());
+    }
+  }
+  return {"strings", to_text(root)};
+}
+
+static Corpus make_matrix(const BenchOptions &opt) {
+  BenchRng rng(4);
+  DataBlock root;
+  for (int i = 0, n = bench_scaled(opt, 6000); i < n; ++i) {
+    DataBlock *blk = root.addNewBlock("node");
+    TMatrix tm;
+    for (int r = 0; r < 4; ++r)
+      for (int c = 0; c < 3; ++c)
+        tm.m[r][c] = rng.uniform(-100.f, 100.f);
+    blk->addTm("tm", tm);
+    blk->addPoint4("bbox", Point4(rng.uniform(-1, 1), rng.uniform(-1, 1), rng.uniform(-1, 1), rng.uniform(0, 10)));
+    blk->addE3dcolor("color", E3DCOLOR(rng.next()));
+  }
+  return {"matrix", to_text(root)};
+}
+
+static Corpus make_includes(const BenchOptions &opt) {
+  BenchRng rng(5);
+  Corpus corpus = {"includes"};
+  char name[64], line[128];
+  for (int i = 0, n = bench_scaled(opt, 400); i < n; ++i) {
+    DataBlock part;
+    add_mixed_params(part, rng, 40);
+    for (int j = 0; j < 3; ++j)
+      add_mixed_params(*part.addNewBlock("sub"), rng, 8);
+    snprintf(name, sizeof(name), "inc_%d.blk", i);
+    corpus.includes.emplace_back(name, to_text(part));
+    snprintf(line, sizeof(line), "part%d {\n  include \"%s\"\n}\n", i % NAME_POOL, name);
+    corpus.text += line;
+  }
+  return corpus;
+}
+
+
+static void collect_blocks(const DataBlock &blk, std::vector<const DataBlock *> &out) {
+  out.push_back(&blk);
+  for (int i = 0; i < blk.blockCount(); ++i)
+    collect_blocks(*blk.getBlock(i), out);
+}
+
+static bool write_file(const std::filesystem::path &path, const std::string &data) {
+  FILE *f = fopen(path.string().c_str(), "wb");
+  if (!f)
+    return false;
+  bool ok = fwrite(data.data(), 1, data.size(), f) == data.size();
+  fclose(f);
+  return ok;
+}
+
+static void run_corpus(BenchReport &report, const Corpus &corpus) {
+  const BenchOptions &opt = report.opt;
+  std::string prefix = std::string("datablock/") + corpus.name + "/";
+
+  // corpora with includes are loaded from disk, others from memory
+  std::filesystem::path dir, mainFile;
+  if (!corpus.includes.empty()) {
+    dir = std::filesystem::temp_directory_path() / "dagutils_bench";
+    std::filesystem::create_directories(dir);
+    mainFile = dir / "main.blk";
+    bool ok = write_file(mainFile, corpus.text);
+    for (auto &inc : corpus.includes)
+      ok = ok && write_file(dir / inc.first, inc.second);
+    if (!ok) {
+      fprintf(stderr, "can't write corpus '%s' to %s\n", corpus.name, dir.string().c_str());
+      return;
+    }
+  }
+  std::string mainPath = mainFile.string();
+  auto load = [&](DataBlock &blk) {
+    return mainPath.empty() ? blk.loadText((char *)corpus.text.data(), int(corpus.text.size())) : blk.load(mainPath.c_str());
+  };
+
+  DataBlock blk;
+  if (!load(blk)) {
+    fprintf(stderr, "corpus '%s' failed to load\n", corpus.name);
+    return;
+  }
+
+  double mb = corpus.totalBytes() / 1e6;
+  if (report.enabled(prefix + "size"))
+    report.add(prefix + "size", double(corpus.totalBytes()), "B");
+
+  if (report.enabled(prefix + "load")) {
+    double ms = bench_median_ms(opt.iterations, [&] { load(blk); });
+    report.add(prefix + "load", mb / (ms / 1000.0), "MB/s");
+
+    // malloc + free + realloc calls, counted only when memory stats are compiled in (DAGOR_DBGLEVEL > 0)
+    if (int64_t calls = dagor_memory_stat::get_malloc_call_count()) {
+      load(blk);
+      report.add(prefix + "load_alloc_calls", double(dagor_memory_stat::get_malloc_call_count() - calls), "calls");
+    }
+  }
+
+  // resident memory taken by loaded tree, in separate process (peak RSS of this one includes all earlier corpora)
+  if (report.enabled(prefix + "load_rss")) {
+    std::filesystem::path file = mainFile;
+    if (file.empty()) { // corpus loaded from memory goes to temporary file
+      file = std::filesystem::temp_directory_path() / (std::string("dagutils_bench_") + corpus.name + ".blk");
+      if (!write_file(file, corpus.text))
+        file.clear();
+    }
+    if (!file.empty())
+      report.add(prefix + "load_rss", double(bench_load_rss_kb(file.string().c_str())), "KB");
+    if (file != mainFile)
+      std::filesystem::remove(file);
+  }
+
+  if (report.enabled(prefix + "lookup")) {
+    std::vector<const DataBlock *> blocks;
+    collect_blocks(blk, blocks);
+    BenchRng rng(42);
+    const int queries = 1 << 16;
+    std::vector<std::pair<const DataBlock *, std::string>> paramQ, blockQ;
+    char name[32];
+    for (int i = 0; i < queries; ++i) {
+      // param names are drawn from the same pool as generated ones, so both hits and misses are measured
+      snprintf(name, sizeof(name), "%c%d", "irbpt"[rng.range(5)], rng.range(NAME_POOL));
+      paramQ.emplace_back(blocks[rng.range(int(blocks.size()))], name);
+      const DataBlock *b = blocks[rng.range(int(blocks.size()))];
+      blockQ.emplace_back(b, b->blockCount() ? b->getBlock(rng.range(b->blockCount()))->getBlockName() : "missing");
+    }
+    int found = 0;
+    double ms = bench_median_ms(opt.iterations, [&] {
+      for (auto &it : paramQ)
+        found += it.first->findParam(it.second.c_str()) >= 0;
+    });
+    report.add(prefix + "lookup_param", ms * 1e6 / queries, "ns/op");
+
+    ms = bench_median_ms(opt.iterations, [&] {
+      for (auto &it : blockQ)
+        found += it.first->getBlockByName(it.second.c_str()) != nullptr;
+    });
+    report.add(prefix + "lookup_block", ms * 1e6 / queries, "ns/op");
+    if (found < 0)
+      fprintf(stderr, "%d\n", found); // keeps lookups from being optimized out
+  }
+
+  if (report.enabled(prefix + "copy")) {
+    double ms = bench_median_ms(opt.iterations, [&] { DataBlock copy(blk); });
+    report.add(prefix + "copy", ms, "ms");
+  }
+
+  if (report.enabled(prefix + "save")) {
+    DynamicMemGeneralSaveCB cb(tmpmem, int(corpus.totalBytes() * 2));
+    double ms = bench_median_ms(opt.iterations, [&] {
+      cb.reset();
+      blk.saveToTextStream(cb);
+    });
+    report.add(prefix + "save", cb.size() / 1e6 / (ms / 1000.0), "MB/s");
+  }
+
+  if (!dir.empty()) {
+    std::error_code ec;
+    std::filesystem::remove_all(dir, ec);
+  }
+}
+
+void bench_datablock(BenchReport &report) {
+  static const struct {
+    const char *name;
+    Corpus (*make)(const BenchOptions &);
+  } corpora[] = {{"wide", make_wide}, {"deep", make_deep}, {"strings", make_strings}, {"matrix", make_matrix}, {"includes", make_includes}};
+
+  for (auto &c : corpora) {
+    std::string prefix = std::string("datablock/") + c.name + "/";
+    bool any = false;
+    for (const char *m : {"size", "load", "load_rss", "lookup", "copy", "save"})
+      any = any || report.enabled(prefix + m);
+    if (any) {
+      fprintf(stderr, "%s\n", prefix.c_str());
+      run_corpus(report, c.make(report.opt));
+    }
+  }
+}
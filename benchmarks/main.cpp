@@ -0,0 +1,145 @@
+#include "bench.h"
+#include <datablock/datablock.h>
+#include <memory/dag_mem.h>
+#include <memory/dag_memStat.h>
+#include <stdlib.h>
+#include <string.h>
+#if defined(_WIN32)
+#include <windows.h>
+#include <psapi.h>
+#define popen  _popen
+#define pclose _pclose
+#elif defined(__APPLE__)
+#include <mach/mach.h>
+#else
+#include <stdio.h>
+#include <unistd.h>
+#endif
+
+void (*dgs_fatal_report)(const char *, const char *) = nullptr;
+
+static const char *exe_path = nullptr;
+
+size_t bench_rss_kb() {
+#if defined(_WIN32)
+  PROCESS_MEMORY_COUNTERS pmc;
+  if (GetProcessMemoryInfo(GetCurrentProcess(), &pmc, sizeof(pmc)))
+    return pmc.WorkingSetSize / 1024;
+  return 0;
+#elif defined(__APPLE__)
+  mach_task_basic_info info;
+  mach_msg_type_number_t count = MACH_TASK_BASIC_INFO_COUNT;
+  if (task_info(mach_task_self(), MACH_TASK_BASIC_INFO, (task_info_t)&info, &count) != KERN_SUCCESS)
+    return 0;
+  return info.resident_size / 1024;
+#else
+  unsigned long size = 0, resident = 0;
+  FILE *f = fopen("/proc/self/statm", "r");
+  if (!f)
+    return 0;
+  int n = fscanf(f, "%lu %lu", &size, &resident);
+  fclose(f);
+  return n == 2 ? resident * (sysconf(_SC_PAGESIZE) / 1024) : 0;
+#endif
+}
+
+// memory freed by earlier measurements stays in allocator and is reused by later loads, so each load is measured
+// in fresh process: this executable is run with --load-rss option (see load_rss_child())
+size_t bench_load_rss_kb(const char *blk_path) {
+  std::string cmd = std::string("\"") + exe_path + "\" --load-rss \"" + blk_path + "\"";
+#if defined(_WIN32)
+  cmd = "\"" + cmd + "\""; // cmd.exe strips outer quotes
+#endif
+  FILE *p = popen(cmd.c_str(), "r");
+  if (!p)
+    return 0;
+  unsigned long long kb = 0;
+  int n = fscanf(p, "%llu", &kb);
+  return pclose(p) == 0 && n == 1 ? size_t(kb) : 0;
+}
+
+static int load_rss_child(const char *blk_path) {
+  size_t before = bench_rss_kb();
+  DataBlock blk;
+  if (!blk.load(blk_path))
+    return 1;
+  size_t after = bench_rss_kb();
+  printf("%llu\n", (unsigned long long)(after > before ? after - before : 0));
+  return 0;
+}
+
+void BenchReport::add(const std::string &name, double value, const char *unit) {
+  results.push_back({name, value, unit});
+  fprintf(stderr, "  %-40s %14.3f %s\n", name.c_str(), value, unit);
+}
+
+void BenchReport::writeJson(FILE *f) const {
+#if defined(__clang__)
+  const char *compiler = "clang " __clang_version__;
+#elif defined(__GNUC__)
+  const char *compiler = "gcc " __VERSION__;
+#elif defined(_MSC_VER)
+  const char *compiler = "msvc";
+#else
+  const char *compiler = "unknown";
+#endif
+#if defined(NDEBUG)
+  const char *build = "release";
+#else
+  const char *build = "debug";
+#endif
+
+  // names and units are plain ASCII identifiers, so no escaping is needed
+  fprintf(f, "{\n  \"schema\": 1,\n");
+  fprintf(f, "  \"config\": {\"iterations\": %d, \"scale\": %g, \"build\": \"%s\", \"compiler\": \"%s\", \"mem_stats\": %s},\n",
+          opt.iterations, opt.scale, build, compiler, dagor_memory_stat::get_malloc_call_count() ? "true" : "false");
+  fprintf(f, "  \"results\": [");
+  for (size_t i = 0; i < results.size(); ++i)
+    fprintf(f, "%s\n    {\"name\": \"%s\", \"value\": %.6g, \"unit\": \"%s\"}", i ? "," : "", results[i].name.c_str(),
+            results[i].value, results[i].unit);
+  fprintf(f, "\n  ]\n}\n");
+}
+
+static void usage() {
+  fprintf(stderr, "usage: dagutils_bench [--iterations N] [--scale F] [--filter SUBSTR] [--out FILE.json]\n"
+                  "Writes JSON results to stdout (or FILE), human-readable progress to stderr.\n");
+}
+
+int main(int argc, char **argv) {
+  dagor_force_init_memmgr();
+  exe_path = argv[0];
+  if (argc == 3 && strcmp(argv[1], "--load-rss") == 0)
+    return load_rss_child(argv[2]);
+
+  BenchOptions opt;
+  const char *out = nullptr;
+  for (int i = 1; i < argc; ++i) {
+    bool hasValue = i + 1 < argc;
+    if (strcmp(argv[i], "--iterations") == 0 && hasValue)
+      opt.iterations = std::max(1, atoi(argv[++i]));
+    else if (strcmp(argv[i], "--scale") == 0 && hasValue)
+      opt.scale = std::max(0.01, atof(argv[++i]));
+    else if (strcmp(argv[i], "--filter") == 0 && hasValue)
+      opt.filter = argv[++i];
+    else if (strcmp(argv[i], "--out") == 0 && hasValue)
+      out = argv[++i];
+    else {
+      usage();
+      return 1;
+    }
+  }
+
+  BenchReport report(opt);
+  bench_datablock(report);
+  bench_bitstream(report);
+
+  FILE *f = out ? fopen(out, "wt") : stdout;
+  if (!f) {
+    fprintf(stderr, "can't write '%s'\n", out);
+    return 1;
+  }
+  report.writeJson(f);
+  if (out)
+    fclose(f);
+  return 0;
+}
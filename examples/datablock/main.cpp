@@ -1,5 +1,6 @@
 #include <datablock/datablock.h>
 #include <debug/dag_assert.h>
+#include <ioSys/dag_memIo.h>
 #include <math/dag_Point3.h>
 #include <memory/dag_mem.h>
 #include <print>
@@ -33,5 +34,9 @@ int main() {
     }
   }
 
+  DynamicMemGeneralSaveCB mem_stream;
+  settings.saveToTextStream(mem_stream);
+  std::println("\nIn-memory text ({} bytes):\n{}", mem_stream.size(), mem_stream.c_str());
+
   return 0;
 }
\ No newline at end of file
@@ -6,12 +6,27 @@
 
 #include <string.h>
 #include <stddef.h>
+#include <stdlib.h>
 #include <generic/dag_span.h>
+#include <EASTL/string_view.h>
 #include <EASTL/type_traits.h>
 #include <EASTL/utility.h>
 #include <debug/dag_assert.h>
 #include <util/dag_globDef.h>
 #include <memory/dag_memBase.h>
+#include <math/dag_bits.h>
+#include <math/dag_half.h>
+#if _TARGET_SIMD_SSE || defined(__SSE2__) || defined(_M_X64) // SSE2 is baseline of x86-64, no target flags needed
+#define BITSTREAM_SIMD_SSE2 1
+#include <emmintrin.h>
+#endif
+// SSSE3 is not baseline: used inline when compiler targets it, otherwise through BITSTREAM_SSSE3_DISPATCH (see below)
+#if !defined(BITSTREAM_SIMD_SSSE3) && (_TARGET_SIMD_SSE >= 4 || defined(__SSSE3__) || defined(__AVX__))
+#define BITSTREAM_SIMD_SSSE3 1
+#endif
+#if BITSTREAM_SIMD_SSSE3
+#include <tmmintrin.h>
+#endif
 
 EA_DISABLE_VC_WARNING(4146) // unary minus operator applied to unsigned type, result still unsigned
 
@@ -20,8 +35,12 @@ class DataBlock;
 namespace danet
 {
 class BitStream;
+class SegmentedBitStream;
 namespace internal
 {
+template <bool checked>
+class BitReader;
+
 #define DECL_HAS_MEMBER(name, mbr)                                                 \
   template <class T, typename Enable = void>                                       \
   struct name : public eastl::false_type                                           \
@@ -48,6 +67,7 @@ DECL_HAS_MEMBER(IsString, c_str);
 DECL_HAS_MEMBER(HaveAllocBuffer, allocBuffer);
 DECL_HAS_MEMBER(IsContainer, resize);
 DECL_HAS_MEMBER(IsOptional, has_value);
+DECL_HAS_MEMBER(HaveResizeNoinit, resize_noinit);
 #undef DECL_HAS_MEMBER
 template <typename T>
 inline typename eastl::enable_if<HaveAllocBuffer<T>::value>::type resize_str(T &str, uint32_t sz)
@@ -60,17 +80,96 @@ inline typename eastl::disable_if<HaveAllocBuffer<T>::value>::type resize_str(T
   str.resize(sz);
 }
 
-template <typename T, typename = decltype(write_type(eastl::declval<BitStream &>(), eastl::declval<T>()))>
+template <typename T>
+inline typename eastl::enable_if<HaveResizeNoinit<T>::value>::type resize_noinit(T &cont, uint32_t sz)
+{
+  cont.resize_noinit(sz);
+}
+template <typename T>
+inline typename eastl::disable_if<HaveResizeNoinit<T>::value>::type resize_noinit(T &cont, uint32_t sz)
+{
+  cont.resize(sz);
+}
+
+template <typename S, typename T, typename = decltype(write_type(eastl::declval<S &>(), eastl::declval<T>()))>
 eastl::true_type supports_write_type_test(const T &);
+template <typename S>
 eastl::false_type supports_write_type_test(...);
-template <typename T>
-using supports_write_type = decltype(supports_write_type_test(eastl::declval<T>()));
+template <typename T, typename S = BitStream>
+using supports_write_type = decltype(supports_write_type_test<S>(eastl::declval<T>()));
 
 template <typename T, typename = decltype(read_type(eastl::declval<const BitStream &>(), eastl::declval<T &>()))>
 eastl::true_type supports_read_type_test(const T &);
 eastl::false_type supports_read_type_test(...);
 template <typename T>
 using supports_read_type = decltype(supports_read_type_test(eastl::declval<T>()));
+
+// elements that are written as raw bytes (see BitStream::Write(const T &)), so contiguous run of them is single block
+template <typename T>
+inline constexpr bool is_raw_element_v = eastl::is_trivially_copyable_v<T> && !eastl::is_same_v<T, bool> &&
+                                         !eastl::is_pointer_v<T> && !supports_write_type<T>::value &&
+                                         !supports_read_type<T>::value;
+template <typename T, typename = void>
+struct IsRawArray : eastl::false_type
+{};
+template <typename T>
+struct IsRawArray<T, eastl::void_t<decltype(eastl::declval<T &>().data())>>
+  : eastl::bool_constant<eastl::is_pointer_v<decltype(eastl::declval<T &>().data())> &&
+                         is_raw_element_v<eastl::remove_pointer_t<decltype(eastl::declval<T &>().data())>>>
+{};
+
+// Stream VByte control byte holds 2-bit byte length codes of 4 values (first value in low bits)
+struct StreamVByteTables
+{
+  uint8_t len[256];         // data bytes of 4 values
+  uint8_t shuffle[256][16]; // pshufb masks that move value bytes to 32-bit lanes, 0x80 gives zero
+  constexpr StreamVByteTables() : len(), shuffle()
+  {
+    for (int c = 0; c < 256; ++c)
+    {
+      int pos = 0;
+      for (int k = 0; k < 4; ++k)
+      {
+        int n = ((c >> (k * 2)) & 3) + 1;
+        for (int b = 0; b < 4; ++b)
+          shuffle[c][k * 4 + b] = b < n ? uint8_t(pos + b) : 0x80;
+        pos += n;
+      }
+      len[c] = uint8_t(pos);
+    }
+  }
+};
+inline constexpr StreamVByteTables stream_vbyte_tables;
+
+#if BITSTREAM_SIMD_SSSE3
+// decodes groups of 4 values while 16 bytes can be loaded at src, returns number of decoded values
+template <bool zigzag>
+inline uint32_t svb_decode_ssse3(const uint8_t *ctrl, const uint8_t *&src, const uint8_t *load_end, uint32_t *values,
+  uint32_t count)
+{
+  const StreamVByteTables &tbl = stream_vbyte_tables;
+  const uint8_t *p = src; // local, so stores to values don't make it reloaded
+  uint32_t i = 0;
+  for (; i + 4 <= count && p + 16 <= load_end; i += 4)
+  {
+    uint32_t c = ctrl[i >> 2];
+    __m128i v = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i *)p), _mm_loadu_si128((const __m128i *)tbl.shuffle[c]));
+    if constexpr (zigzag)
+      v = _mm_xor_si128(_mm_srli_epi32(v, 1), _mm_sub_epi32(_mm_setzero_si128(), _mm_and_si128(v, _mm_set1_epi32(1))));
+    _mm_storeu_si128((__m128i *)(values + i), v);
+    p += tbl.len[c];
+  }
+  src = p;
+  return i;
+}
+#endif
+#if BITSTREAM_SSSE3_DISPATCH
+// x86-64 baseline build: svb_decode_ssse3() is compiled with SSSE3 in bitstreamSsse3.cpp and called when CPU supports it
+// (false until static initialization of that file is done, so earlier calls use scalar decoding)
+extern const bool svb_ssse3_supported;
+uint32_t svb_decode_ssse3_dispatch(const uint8_t *ctrl, const uint8_t *&src, const uint8_t *load_end, uint32_t *values,
+  uint32_t count, bool zigzag);
+#endif
 }; // namespace internal
 
 class BitStream
@@ -186,44 +285,45 @@ public:
     reserveBits(bits);
 
     uint32_t bitsUsedMod8 = bitsUsed & 7;
-    uint32_t bitsMod8 = bits & 7;
-    const uint8_t *srcPtr = input;
-    uint8_t *destPtr = GetData() + (bitsUsed >> 3);
-
-    if (!bitsUsedMod8 && !bitsMod8)
+    uint32_t bytes = bits >> 3, tailBits = bits & 7;
+    if (!bitsUsedMod8 && !tailBits)
     {
-      memcpy(destPtr, srcPtr, bits >> 3);
+      memcpy(GetData() + (bitsUsed >> 3), input, bytes);
       bitsUsed += bits;
       return;
     }
 
-    uint8_t upShift = 8 - bitsUsedMod8; // also how many remaining free bits in byte left
-    uint8_t srcByte;
-    uint8_t destByte = *destPtr & (0xff << upShift); // clear low bits
-
-    bitsUsed += bits;
-
-    for (; bits >= 8; bits -= 8)
+    // Whole bytes go MSB first, then low bits of last partial byte. Bits are gathered in register: each 8 input bytes
+    // are stored as one shifted word, the rest is merged into stream by writeBitsWord(), keeping bits around it intact.
+    uint64_t acc = 0;
+    uint32_t accBits = 0;
+    if (bytes >= 8)
     {
-      srcByte = *srcPtr++;
-      *destPtr++ = destByte | (srcByte >> bitsUsedMod8);
-      destByte = srcByte << upShift;
-    }
-    if (!bits)
-    {
-      *destPtr = destByte | (*destPtr & (0xff >> bitsUsedMod8));
-      return;
+      uint8_t *destPtr = GetData() + (bitsUsed >> 3);
+      acc = bitsUsedMod8 ? *destPtr >> (8 - bitsUsedMod8) : 0; // leading bits of first byte
+      for (; bytes >= 8; bytes -= 8, input += 8, destPtr += 8)
+      {
+        uint64_t w = loadBE64(input);
+        storeBE64(destPtr, bitsUsedMod8 ? (acc << (64 - bitsUsedMod8)) | (w >> bitsUsedMod8) : w);
+        acc = w;
+      }
+      bitsUsed = bytes2bits(uint32_t(destPtr - GetData()));
+      accBits = bitsUsedMod8;
     }
-    srcByte = *srcPtr & ((1 << bits) - 1);
-    int bitsDiff = (int)bits - (int)upShift;
-    if (bitsDiff <= 0) // enough space left in byte to fit remaining bits?
+    for (; bytes; --bytes, accBits += 8) // less than 8 bytes left, so accBits stays within 63
+      acc = (acc << 8) | *input++;
+    if (tailBits)
     {
-      *destPtr = destByte | (*destPtr & (0xff >> (bits + bitsUsedMod8))) | (srcByte << -bitsDiff);
-      return;
+      if (accBits > 64 - tailBits)
+      {
+        writeBitsWord(acc, accBits);
+        accBits = 0;
+      }
+      acc = (acc << tailBits) | (*input & ((1u << tailBits) - 1));
+      accBits += tailBits;
     }
-    *destPtr++ = destByte | (srcByte >> bitsDiff);
-    bits -= upShift;
-    *destPtr = (*destPtr & (0xff >> bits)) | ((srcByte & ((1 << bits) - 1)) << (8 - bits));
+    if (accBits)
+      writeBitsWord(acc, accBits);
   }
 
   bool ReadBits(uint8_t *output, uint32_t bits) const
@@ -238,39 +338,7 @@ public:
 #endif
       return false;
     }
-
-    const uint8_t *dataPtr = GetData();
-    uint32_t readmod8 = readOffset & 7;
-    if (readmod8 == 0 && (bits & 7) == 0) // fast path - everything byte aligned
-    {
-      memcpy(output, dataPtr + bits2bytes(readOffset), bits2bytes(bits));
-      readOffset += bits;
-      return true;
-    }
-
-    memset(output, 0, bits2bytes(bits));
-
-    uint32_t offs = 0;
-    while (bits > 0)
-    {
-      *(output + offs) |= *(dataPtr + (readOffset >> 3)) << readmod8;
-
-      if (readmod8 > 0 && bits > (8 - readmod8))
-        *(output + offs) |= *(dataPtr + (readOffset >> 3) + 1) >> (8 - readmod8);
-
-      if (bits >= 8)
-      {
-        bits -= 8;
-        readOffset += 8;
-        offs++;
-      }
-      else
-      {
-        *(output + offs) >>= 8 - bits;
-        readOffset += bits;
-        break;
-      }
-    }
+    readBitsNoCheck(output, bits);
     return true;
   }
 
@@ -334,25 +402,39 @@ public:
   {
     return read_type(*this, t);
   }
+  // for temporary proxies that refer to actual destination, e.g. danet::quat_smallest3(rot)
+  template <typename T>
+  eastl::enable_if_t<!eastl::is_lvalue_reference_v<T> && internal::supports_read_type<T>::value, bool> Read(T &&t) const
+  {
+    return read_type(*this, t);
+  }
 
   template <typename T>
   typename eastl::enable_if<internal::IsContainer<T>::value && !internal::IsString<T>::value>::type Write(const T &cont)
   {
     uint32_t sz = (uint32_t)cont.size(), rsz = 0;
     WriteCompressed(sz);
-    for (auto &elem : cont)
+    if constexpr (internal::IsRawArray<T>::value)
+      WriteBits((const uint8_t *)cont.data(), bytes2bits(sz * (uint32_t)sizeof(*cont.data())));
+    else
     {
-      Write(elem);
-      ++rsz;
+      for (auto &elem : cont)
+      {
+        Write(elem);
+        ++rsz;
+      }
+      G_ASSERT(rsz == sz);
     }
-    G_ASSERT(rsz == sz);
     G_UNUSED(sz);
   }
   template <typename T, size_t asz>
   void Write(const T (&cont)[asz])
   {
-    for (auto &elem : cont)
-      Write(elem);
+    if constexpr (internal::is_raw_element_v<T>)
+      WriteBits((const uint8_t *)cont, bytes2bits(sizeof(cont)));
+    else
+      for (auto &elem : cont)
+        Write(elem);
   }
   template <typename T>
   typename eastl::enable_if<internal::IsContainer<T>::value && !internal::IsString<T>::value, bool>::type Read(T &cont) const
@@ -360,6 +442,14 @@ public:
     uint32_t sz = 0;
     if (!ReadCompressed(sz))
       return false;
+    if constexpr (internal::IsRawArray<T>::value)
+    {
+      uint64_t bits = uint64_t(sz) * sizeof(*cont.data()) * 8;
+      if (bits > GetNumberOfUnreadBits()) // checked before resize, so corrupt size doesn't allocate
+        return false;
+      internal::resize_noinit(cont, sz); // every element is overwritten
+      return ReadBits((uint8_t *)cont.data(), uint32_t(bits));
+    }
     cont.resize(sz);
     for (uint32_t i = 0; i < sz; ++i)
       if (!Read(cont[i]))
@@ -369,6 +459,8 @@ public:
   template <typename T, size_t asz>
   bool Read(T (&cont)[asz])
   {
+    if constexpr (internal::is_raw_element_v<T>)
+      return ReadBits((uint8_t *)cont, bytes2bits(sizeof(cont)));
     for (auto &elem : cont)
       if (!Read(elem))
         return false;
@@ -404,7 +496,7 @@ public:
   template <typename B> // Template to avoid implicit types overloads to bool
   typename eastl::enable_if<eastl::is_same<B, bool>::value>::type Write(B f)
   {
-    f ? Write1() : Write0();
+    writeBit(f ? 1 : 0);
   }
 
   //
@@ -420,6 +512,105 @@ public:
   void WriteCompressed(uint16_t v) { writeCompressedUnsignedGeneric(v); }
   bool ReadCompressed(uint16_t &v) const { return readCompressedUnsignedGeneric(v); }
 
+  void WriteCompressed(int64_t v) { writeCompressedSignedGeneric(v); }
+  bool ReadCompressed(int64_t &v) const { return readCompressedSignedGeneric(v); }
+  void WriteCompressed(uint64_t v) { writeCompressedUnsignedGeneric(v); }
+  bool ReadCompressed(uint64_t &v) const { return readCompressedUnsignedGeneric(v); }
+
+  //
+  // Arrays of 32-bit integers in Stream VByte layout (https://arxiv.org/abs/1709.08990): control bytes with 2-bit byte
+  // length of every value, then 1..4 little-endian bytes per value (signed ones are zigzag encoded like in VLQ).
+  // Both parts are byte aligned, so array starts at byte boundary; count is not written.
+  // Decoding uses pshufb when compiled for SSSE3, or when CPU supports it in default build (DAGUTILS_SSSE3 CMake option).
+  //
+  template <typename T>
+  void WriteCompressedArray(const T *values, uint32_t count)
+  {
+    static_assert(eastl::is_integral_v<T> && sizeof(T) == 4);
+    if (!count)
+      return;
+    AlignWriteToByteBoundary();
+    uint32_t ctrlBytes = (count + 3) / 4;
+    reserveBits(bytes2bits(ctrlBytes + count * 4));
+    uint8_t *ctrl = GetData() + (bitsUsed >> 3), *dst = ctrl + ctrlBytes;
+    for (uint32_t i = 0; i < count; i += 4)
+    {
+      uint32_t c = 0;
+      for (uint32_t k = 0, n = min(count - i, 4u); k < n; ++k)
+      {
+        uint32_t v = svbEncode(values[i + k]);
+        uint32_t code = (v > 0xff) + (v > 0xffff) + (v > 0xffffff);
+        c |= code << (k * 2);
+        if (DAGOR_LIKELY(i + k + 3 < count)) // following values overwrite excess bytes, so stream end stays intact
+          storeLE32(dst, v);
+        else
+          for (uint32_t b = 0; b <= code; ++b)
+            dst[b] = uint8_t(v >> (b * 8));
+        dst += code + 1;
+      }
+      *ctrl++ = uint8_t(c);
+    }
+    bitsUsed = bytes2bits(uint32_t(dst - GetData()));
+  }
+  template <typename T>
+  bool ReadCompressedArray(T *values, uint32_t count) const
+  {
+    static_assert(eastl::is_integral_v<T> && sizeof(T) == 4);
+    if (!count)
+      return true;
+    AlignReadToByteBoundary();
+    const internal::StreamVByteTables &tbl = internal::stream_vbyte_tables;
+    uint32_t ctrlBytes = (count + 3) / 4, tail = count & 3;
+    if (readOffset + bytes2bits(ctrlBytes) > bitsUsed)
+      return false;
+    const uint8_t *ctrl = GetData() + (readOffset >> 3), *src = ctrl + ctrlBytes;
+    const uint8_t *end = GetData() + (bitsUsed >> 3), *loadEnd = GetData() + (bitsAllocated >> 3);
+    size_t dataBytes = 0;
+    for (uint32_t i = 0; i < count / 4; ++i)
+      dataBytes += tbl.len[ctrl[i]];
+    if (tail) // codes of missing values are ignored
+      dataBytes += tbl.len[ctrl[count / 4] & ((1 << (tail * 2)) - 1)] - (4 - tail);
+    if (size_t(end - src) < dataBytes)
+      return false;
+
+    uint32_t i = 0;
+#if BITSTREAM_SIMD_SSSE3
+    i = internal::svb_decode_ssse3<eastl::is_signed_v<T>>(ctrl, src, loadEnd, (uint32_t *)values, count);
+#elif BITSTREAM_SSSE3_DISPATCH
+    if (internal::svb_ssse3_supported)
+      i = internal::svb_decode_ssse3_dispatch(ctrl, src, loadEnd, (uint32_t *)values, count, eastl::is_signed_v<T>);
+#endif
+    for (; i < count; ++i)
+    {
+      uint32_t code = (ctrl[i >> 2] >> ((i & 3) * 2)) & 3, v = 0;
+      if (DAGOR_LIKELY(src + 4 <= loadEnd))
+        v = loadLE32(src) & (~0u >> ((3 - code) * 8));
+      else
+        for (uint32_t b = 0; b <= code; ++b)
+          v |= uint32_t(src[b]) << (b * 8);
+      values[i] = svbDecode<T>(v);
+      src += code + 1;
+    }
+    readOffset = bytes2bits(uint32_t(src - GetData()));
+    return true;
+  }
+  // container versions also write size
+  template <typename T>
+  void WriteCompressedArray(const T &cont)
+  {
+    WriteCompressed(uint32_t(cont.size()));
+    WriteCompressedArray(cont.data(), uint32_t(cont.size()));
+  }
+  template <typename T>
+  bool ReadCompressedArray(T &cont) const
+  {
+    uint32_t sz = 0;
+    if (!ReadCompressed(sz) || sz > GetNumberOfUnreadBits() / 8) // at least byte per value
+      return false;
+    cont.resize(sz);
+    return ReadCompressedArray(cont.data(), sz);
+  }
+
   // aligned bytes read/write
   void WriteAlignedBytes(const uint8_t *input, uint32_t bytesLen)
   {
@@ -468,28 +659,37 @@ public:
     *input = (char *)memalloc(ilen, allocator);
     return ReadAlignedBytes((uint8_t *)*input, (uint32_t)ilen);
   }
-
-  // bools
-  void Write0()
+  // Same as ReadAlignedBytesSafe(), but without copy: view points into stream data. Empty data is not an error here.
+  bool ReadAlignedBytesView(dag::ConstSpan<uint8_t> &bytes, uint32_t maxLen = ~0u) const
   {
-    reserveBits(1);
-    const uint32_t bitsmod8 = bitsUsed & 7;
-    if (!(bitsUsed & 7))
-      GetData()[bitsUsed >> 3] = 0;
-    else
-      GetData()[bitsUsed >> 3] &= ~(0x80 >> bitsmod8);
-    bitsUsed++;
+    uint32_t len = 0;
+    const uint8_t *ptr = nullptr;
+    bytes = {};
+    if (!ReadCompressed(len))
+      return false;
+    len = min(len, maxLen);
+    if (len) // nothing is aligned for empty data, see WriteAlignedBytesSafe()
+      AlignReadToByteBoundary();
+    if (!readBytesView(ptr, len, nullptr, 0))
+      return false;
+    bytes = dag::ConstSpan<uint8_t>(ptr, len);
+    return true;
   }
-  void Write1()
+  // Same as Read(char *, len), but view points into stream data when bytes are byte aligned, otherwise they are copied
+  // to scratch (read fails if it is too small).
+  bool ReadBytesView(dag::ConstSpan<uint8_t> &bytes, uint32_t len, dag::Span<uint8_t> scratch = {}) const
   {
-    reserveBits(1);
-    const uint32_t bitsmod8 = bitsUsed & 7;
-    if (!bitsmod8)
-      GetData()[bitsUsed >> 3] = 0x80;
-    else
-      GetData()[bitsUsed >> 3] |= 0x80 >> bitsmod8;
-    bitsUsed++;
+    const uint8_t *ptr = nullptr;
+    bytes = {};
+    if (!readBytesView(ptr, len, scratch.data(), scratch.size()))
+      return false;
+    bytes = dag::ConstSpan<uint8_t>(ptr, len);
+    return true;
   }
+
+  // bools
+  void Write0() { writeBit(0); }
+  void Write1() { writeBit(1); }
   bool ReadBit() const
   {
     G_ASSERT(readOffset < bitsUsed);
@@ -505,6 +705,78 @@ public:
     return true;
   }
 
+  // integer fields of 0..64 bits, MSB first and independent of host byte order (e.g. enums, flag sets, quantized values)
+  void WriteBitsValue(uint64_t v, uint32_t nbits)
+  {
+    G_ASSERT(nbits <= 64);
+    if (!nbits)
+      return;
+    reserveBits(nbits);
+    writeBitsWord(v, nbits);
+  }
+  // signed types are sign extended from nbits
+  template <typename T>
+  bool ReadBitsValue(T &v, uint32_t nbits) const
+  {
+    static_assert(eastl::is_integral_v<T> || eastl::is_enum_v<T>);
+    G_ASSERT(nbits <= sizeof(T) * CHAR_BIT);
+    if (readOffset + nbits > bitsUsed)
+      return false;
+    v = readBitsValueNoCheck<T>(nbits);
+    return true;
+  }
+  // compile-time width variants, e.g. WriteBitsValue<5>(state) / ReadBitsValue<5>(state)
+  template <uint32_t nbits, typename T>
+  void WriteBitsValue(T v)
+  {
+    static_assert((eastl::is_integral_v<T> || eastl::is_enum_v<T>) && nbits > 0 && nbits <= sizeof(T) * CHAR_BIT);
+    reserveBits(nbits);
+    writeBitsWord((uint64_t)v, nbits);
+  }
+  template <uint32_t nbits, typename T>
+  bool ReadBitsValue(T &v) const
+  {
+    static_assert(nbits > 0 && nbits <= sizeof(T) * CHAR_BIT);
+    return ReadBitsValue(v, nbits);
+  }
+
+  // integers within [min_v, max_v] take ceil(log2(max_v - min_v + 1)) bits; values outside are clamped on both sides
+  void WriteRanged(int v, int min_v, int max_v) { WriteBitsValue(rangedToBits(v, min_v, max_v), rangedBits(min_v, max_v)); }
+  bool ReadRanged(int &v, int min_v, int max_v) const
+  {
+    uint32_t r = 0;
+    if (!ReadBitsValue(r, rangedBits(min_v, max_v)))
+      return false;
+    v = bitsToRanged(r, min_v, max_v);
+    return true;
+  }
+
+  // floats within [min_v, max_v] mapped uniformly to nbits (1..32) with rounding: max error is
+  // (max_v - min_v) / (2^(nbits+1) - 2), both ends are exact; values outside are clamped, NaN is written as min_v
+  void WriteQuantized(float v, float min_v, float max_v, uint32_t nbits)
+  {
+    WriteBitsValue(quantize(v, min_v, max_v, nbits), nbits);
+  }
+  bool ReadQuantized(float &v, float min_v, float max_v, uint32_t nbits) const
+  {
+    uint32_t q = 0;
+    if (!ReadBitsValue(q, nbits))
+      return false;
+    v = dequantize(q, min_v, max_v, nbits);
+    return true;
+  }
+
+  // IEEE half precision (16 bits): 11 significant bits, finite up to 65504, larger values become Inf
+  void WriteHalf(float v) { WriteBitsValue(float_to_half(v), 16); }
+  bool ReadHalf(float &v) const
+  {
+    uint16_t h = 0;
+    if (!ReadBitsValue(h, 16))
+      return false;
+    v = half_to_float(h);
+    return true;
+  }
+
   // other
   uint32_t CopyData(uint8_t **_data) const
   {
@@ -551,8 +823,8 @@ public:
   template <typename T>
   typename eastl::enable_if<internal::IsString<T>::value, bool>::type Read(T &t) const
   {
-    uint16_t l = 0;
-    bool r = ReadCompressed(l);
+    uint32_t l = 0;
+    bool r = ReadCompressed(l) && uint64_t(l) * 8 <= GetNumberOfUnreadBits(); // corrupt length is not allocated
     if (l && r)
     {
       internal::resize_str(t, l);
@@ -563,6 +835,19 @@ public:
     return r;
   }
 
+  // String written by Write(const char *) or Write(const T &str), without copy when its bytes are byte aligned (see
+  // ReadBytesView()). View is not null terminated and is valid while stream data (or scratch) is.
+  bool ReadStringView(eastl::string_view &str, dag::Span<char> scratch = {}) const
+  {
+    uint32_t l = 0;
+    const uint8_t *ptr = nullptr;
+    str = {};
+    if (!ReadCompressed(l) || !readBytesView(ptr, l, (uint8_t *)scratch.data(), scratch.size()))
+      return false;
+    str = eastl::string_view((const char *)ptr, l);
+    return true;
+  }
+
   void Write(const DataBlock &blk);
   bool Read(DataBlock &blk) const;
 
@@ -590,6 +875,10 @@ public:
   void swap(BitStream &bs);
 
 protected:
+  template <bool checked>
+  friend class internal::BitReader;
+  friend class SegmentedBitStream;
+
   template <typename T>
   void writeCompressedSignedGeneric(T v)
   {
@@ -609,41 +898,268 @@ protected:
     return true;
   }
 
+  // Little-endian groups of 7 bits, high bit of byte is set when more bytes follow. Values are encoded and decoded
+  // as 64-bit words without per-byte branches, only single byte values take shortcut (plain store or early exit).
   template <typename T>
   void writeCompressedUnsignedGeneric(T v)
   {
     G_STATIC_ASSERT(eastl::is_unsigned<T>::value);
-    for (int i = 0; i < sizeof(v) + 1; ++i)
+    const uint32_t maxBytes = (sizeof(T) * CHAR_BIT + 6) / 7;
+    uint64_t x = v;
+    if (x < 0x80 && !(bitsUsed & 7) && bitsUsed < bitsAllocated)
     {
-      uint8_t byte = uint8_t(v) | (v >= (1 << 7) ? (1 << 7) : 0);
-      Write(byte);
-      v >>= 7;
-      if (!v)
-        break;
+      GetData()[bitsUsed >> 3] = uint8_t(x);
+      bitsUsed += 8;
+      return;
     }
+    uint32_t n = vlqBytes(x, maxBytes);
+    reserveBits(bytes2bits(n));
+    writeBitsWord(vlqWord(x, n), bytes2bits(min(n, 8u)));
+    if (n > 8) // 64-bit values only
+      writeBitsWord(vlqWord(x >> 56, n - 8), bytes2bits(n - 8));
   }
 
   template <typename T>
   bool readCompressedUnsignedGeneric(T &v) const
   {
     G_STATIC_ASSERT(eastl::is_unsigned<T>::value);
-    v = 0;
-    for (int i = 0; i < sizeof(v) + 1; ++i)
+    const uint32_t maxBytes = (sizeof(T) * CHAR_BIT + 6) / 7;
+    const uint32_t wordBytes = min(maxBytes, 7u); // whole bytes in 64-bit load at any bit offset
+    uint64_t x = 0;
+    uint32_t i = 0;
+    if (DAGOR_LIKELY(readOffset + 64 <= bitsUsed))
     {
-      uint8_t byte = 0;
-      if (!Read(byte))
+      uint64_t w = loadBE64(GetData() + (readOffset >> 3)) << (readOffset & 7);
+      if (!(w >> 63))
+      {
+        v = T(w >> 56);
+        readOffset += 8;
+        return true;
+      }
+      // first byte without continuation bit ends value, last byte of type ends it anyway
+      uint64_t stop = (~w | (uint64_t(0x80) << (64 - bytes2bits(wordBytes)))) & VLQ_CONT_BITS;
+      uint32_t n = (clz64(stop) >> 3) + 1;
+      readOffset += bytes2bits(n);
+      x = vlqCompact(bswap64(w & (~uint64_t(0) << (64 - bytes2bits(n)))));
+      if (maxBytes <= 7 || !((w << bytes2bits(n - 1)) >> 63))
+      {
+        v = T(x);
+        return true;
+      }
+      i = n; // 64-bit value above 2^49
+    }
+    for (; i < maxBytes; ++i)
+    {
+      if (readOffset + 8 > bitsUsed)
+      {
+        v = T(x);
         return false;
-      v |= T(byte & ~(1 << 7)) << (i * 7);
-      if ((byte & (1 << 7)) == 0)
+      }
+      uint32_t byte = uint32_t(readBitsWord(8));
+      x |= uint64_t(byte & 0x7f) << (i * 7);
+      if (!(byte & 0x80))
         break;
     }
+    v = T(x);
     return true;
   }
 
+  static constexpr uint64_t VLQ_CONT_BITS = 0x8080808080808080ull;
+  // low 56 bits of x to 7-bit groups in low bits of bytes, and back
+  static inline uint64_t vlqSpread(uint64_t x)
+  {
+    x = (x & 0x000000000fffffffull) | ((x & 0x00fffffff0000000ull) << 4);
+    x = (x & 0x00003fff00003fffull) | ((x & 0x0fffc0000fffc000ull) << 2);
+    return (x & 0x007f007f007f007full) | ((x & 0x3f803f803f803f80ull) << 1);
+  }
+  static inline uint64_t vlqCompact(uint64_t x)
+  {
+    x = (x & 0x007f007f007f007full) | ((x & 0x7f007f007f007f00ull) >> 1);
+    x = (x & 0x00003fff00003fffull) | ((x & 0x3fff00003fff0000ull) >> 2);
+    return (x & 0x000000000fffffffull) | ((x & 0x0fffffff00000000ull) >> 4);
+  }
+  // number of bytes in encoding of x, at most max_bytes
+  static inline uint32_t vlqBytes(uint64_t x, uint32_t max_bytes)
+  {
+    uint32_t n = 1;
+    for (uint32_t i = 1; i < max_bytes; ++i)
+      n += x >= (uint64_t(1) << (i * 7));
+    return n;
+  }
+  // first min(n, 8) bytes of n byte encoding of x, in low bits in stream order; rest of 64-bit value is vlqWord(x >> 56, n - 8)
+  static inline uint64_t vlqWord(uint64_t x, uint32_t n)
+  {
+    uint64_t contMask = n > 8 ? ~uint64_t(0) : (uint64_t(1) << bytes2bits(n - 1)) - 1; // all bytes but last
+    return bswap64(vlqSpread(x) | (VLQ_CONT_BITS & contMask)) >> (64 - bytes2bits(min(n, 8u)));
+  }
+
+  // Writes low n bits of v (1..64), MSB first, keeping other bits of stream intact; space must be reserved.
+  // Stream is accessed by 64-bit words at multiples of 8 bytes from start, so sequential writes load back exactly
+  // what previous one stored.
+  void writeBitsWord(uint64_t v, uint32_t n)
+  {
+    uint32_t wordOffs = (bitsUsed >> 6) << 3, end = (bitsUsed & 63) + n;
+    uint8_t *destPtr = GetData() + wordOffs;
+    v &= ~uint64_t(0) >> (64 - n);
+    if (DAGOR_LIKELY(wordOffs + 16 <= (bitsAllocated >> 3)))
+    {
+      if (end <= 64)
+      {
+        uint64_t mask = (~uint64_t(0) >> (64 - n)) << (64 - end);
+        storeBE64(destPtr, (loadBE64(destPtr) & ~mask) | (v << (64 - end)));
+      }
+      else
+      {
+        uint32_t rest = end - 64; // bits going to next word
+        uint64_t mask = ~uint64_t(0) >> (64 - (n - rest));
+        storeBE64(destPtr, (loadBE64(destPtr) & ~mask) | (v >> rest));
+        mask = ~uint64_t(0) << (64 - rest);
+        storeBE64(destPtr + 8, (loadBE64(destPtr + 8) & ~mask) | (v << (64 - rest)));
+      }
+    }
+    else // near end of buffer only touched bytes are accessed
+    {
+      destPtr = GetData() + (bitsUsed >> 3);
+      for (uint32_t bitOffs = bitsUsed & 7, left = n; left;)
+      {
+        uint32_t cnt = min(8 - bitOffs, left), shift = 8 - bitOffs - cnt;
+        uint32_t mask = ((1u << cnt) - 1) << shift;
+        left -= cnt;
+        *destPtr = uint8_t((*destPtr & ~mask) | ((uint32_t(v >> left) << shift) & mask));
+        destPtr++;
+        bitOffs = 0;
+      }
+    }
+    bitsUsed += n;
+  }
+
+  template <typename T>
+  T readBitsValueNoCheck(uint32_t nbits) const
+  {
+    return bitsToValue<T>(nbits ? readBitsWord(nbits) : 0, nbits);
+  }
+  // value of nbits low bits, sign-extended for signed T
+  template <typename T>
+  static T bitsToValue(uint64_t r, uint32_t nbits)
+  {
+    if constexpr (eastl::is_signed_v<T>)
+      if (nbits && nbits < 64)
+        r = (r ^ (uint64_t(1) << (nbits - 1))) - (uint64_t(1) << (nbits - 1));
+    return (T)r;
+  }
+
+  // ReadBits() without bounds check
+  void readBitsNoCheck(uint8_t *output, uint32_t bits) const { readBitsNoCheck(GetData(), bitsAllocated, readOffset, output, bits); }
+  // same from buffer of buf_bits at given offset, which is moved past read bits
+  static void readBitsNoCheck(const uint8_t *buf, uint32_t buf_bits, uint32_t &offset, uint8_t *output, uint32_t bits)
+  {
+    const uint8_t *dataPtr = buf + (offset >> 3);
+    uint32_t readmod8 = offset & 7;
+    uint32_t bytes = bits >> 3, tailBits = bits & 7;
+    if (readmod8 == 0 && tailBits == 0) // fast path - everything byte aligned
+    {
+      memcpy(output, dataPtr, bytes);
+      offset += bits;
+      return;
+    }
+
+    if (bytes >= 8)
+    {
+      // misaligned bulk: each output byte is combined from two neighbouring stream bytes, both holding read bits
+      const uint8_t *startPtr = dataPtr;
+      if (!readmod8)
+      {
+        memcpy(output, dataPtr, bytes & ~7u);
+        dataPtr += bytes & ~7u;
+        output += bytes & ~7u;
+      }
+      else
+      {
+#if BITSTREAM_SIMD_SSE2
+        const __m128i shl = _mm_cvtsi32_si128(readmod8), shr = _mm_cvtsi32_si128(8 - readmod8);
+        const __m128i hiMask = _mm_set1_epi8(char(0xFF << readmod8)), loMask = _mm_set1_epi8(char(0xFF >> (8 - readmod8)));
+        for (; bytes >= 16; bytes -= 16, dataPtr += 16, output += 16)
+        {
+          __m128i cur = _mm_loadu_si128((const __m128i *)dataPtr), next = _mm_loadu_si128((const __m128i *)(dataPtr + 1));
+          _mm_storeu_si128((__m128i *)output,
+            _mm_or_si128(_mm_and_si128(_mm_sll_epi16(cur, shl), hiMask), _mm_and_si128(_mm_srl_epi16(next, shr), loMask)));
+        }
+#endif
+        for (; bytes >= 8; bytes -= 8, dataPtr += 8, output += 8)
+          storeBE64(output, (loadBE64(dataPtr) << readmod8) | (dataPtr[8] >> (8 - readmod8)));
+      }
+      offset += bytes2bits(uint32_t(dataPtr - startPtr));
+      bytes &= 7;
+    }
+
+    // less than 64 bits left: whole bytes MSB first, last partial byte gets its bits as low ones
+    uint32_t n = bytes2bits(bytes) + tailBits;
+    if (!n)
+      return;
+    uint64_t v = readBitsWord(buf, buf_bits, offset, n);
+    for (uint32_t i = 0; i < bytes; ++i)
+      output[i] = uint8_t(v >> (n - (i + 1) * 8));
+    if (tailBits)
+      output[bytes] = uint8_t(v & ((1u << tailBits) - 1));
+  }
+
+
+  // Reads n bits (1..64) MSB first; bounds must be checked by caller. Up to 57 bits at any bit offset are taken
+  // from single unaligned 64-bit load, last bytes of buffer are read one by one.
+  uint64_t readBitsWord(uint32_t n) const { return readBitsWord(GetData(), bitsAllocated, readOffset, n); }
+  static uint64_t readBitsWord(const uint8_t *buf, uint32_t buf_bits, uint32_t &offset, uint32_t n)
+  {
+    uint32_t byteOffs = offset >> 3, bitOffs = offset & 7;
+    const uint8_t *srcPtr = buf + byteOffs;
+    uint64_t v = 0;
+    if (DAGOR_LIKELY(byteOffs + 8 <= (buf_bits >> 3)))
+      v = loadBE64(srcPtr) << bitOffs;
+    else
+    {
+      for (uint32_t i = 0, cnt = min(bits2bytes(bitOffs + n), 8u); i < cnt; ++i)
+        v |= uint64_t(srcPtr[i]) << (56 - i * 8);
+      v <<= bitOffs;
+    }
+    if (bitOffs + n > 64)
+      v |= srcPtr[8] >> (8 - bitOffs);
+    offset += n;
+    return v >> (64 - n);
+  }
+
+  // starting new byte clears rest of it, otherwise single bit is changed
+  void writeBit(uint32_t bit)
+  {
+    if (DAGOR_UNLIKELY(bitsUsed >= bitsAllocated))
+      reserveBits(1);
+    uint8_t *destPtr = GetData() + (bitsUsed >> 3);
+    uint32_t shift = 7 - (bitsUsed & 7);
+    *destPtr = uint8_t(((bitsUsed & 7) ? *destPtr & ~(1u << shift) : 0u) | (bit << shift));
+    bitsUsed++;
+  }
+
+  // points to len bytes at read offset: to stream data when it is byte aligned, otherwise to their copy in scratch
+  bool readBytesView(const uint8_t *&ptr, uint32_t len, uint8_t *scratch, uint32_t scratchLen) const
+  {
+    if (uint64_t(readOffset) + (uint64_t(len) << 3) > bitsUsed)
+      return false;
+    if (!(readOffset & 7) || !len)
+    {
+      ptr = GetData() + (readOffset >> 3);
+      readOffset += len << 3;
+      return true;
+    }
+    if (len > scratchLen)
+      return false;
+    ptr = scratch;
+    return ReadBits(scratch, bytes2bits(len));
+  }
+
+  // Length is 32-bit VLQ. Below 64K it is encoded same as 16-bit one used before, so old streams are read as is
+  // and strings of older sizes can still be read by older code.
   void writeString(const char *str, size_t str_len)
   {
-    G_ASSERT(uint16_t(str_len) == str_len);
-    WriteCompressed((uint16_t)str_len);
+    G_ASSERT(uint32_t(str_len) == str_len);
+    WriteCompressed((uint32_t)str_len);
     if (str_len)
       Write(str, (uint32_t)str_len);
   }
@@ -660,6 +1176,112 @@ protected:
   }
 
   static inline uint32_t bits2bytes(uint32_t bi) { return (bi + 7) >> 3; }
+  static inline uint32_t rangeBits(uint32_t range) // bits to store 0..range
+  {
+#if HAS_BIT_SCAN_FORWARD
+    return range ? __bsr_unsafe(int(range)) + 1 : 0;
+#else
+    uint32_t n = 0;
+    for (; range; range >>= 1)
+      n++;
+    return n;
+#endif
+  }
+  static inline double quantSteps(uint32_t nbits) { return double(~uint64_t(0) >> (64 - nbits)); }
+
+  // value mappings of WriteRanged() / WriteQuantized(), shared by streams and readers
+  static inline uint32_t rangedBits(int min_v, int max_v) { return rangeBits(uint32_t(max_v) - uint32_t(min_v)); }
+  static inline uint32_t rangedToBits(int v, int min_v, int max_v)
+  {
+    G_ASSERT(min_v <= max_v);
+    v = v < min_v ? min_v : (v > max_v ? max_v : v);
+    return uint32_t(v) - uint32_t(min_v);
+  }
+  static inline int bitsToRanged(uint32_t r, int min_v, int max_v)
+  {
+    return int(uint32_t(min_v) + min(r, uint32_t(max_v) - uint32_t(min_v)));
+  }
+  static inline uint32_t quantize(float v, float min_v, float max_v, uint32_t nbits)
+  {
+    G_ASSERT(nbits > 0 && nbits <= 32 && min_v < max_v);
+    double steps = quantSteps(nbits), q = (double(v) - min_v) * (steps / (double(max_v) - min_v));
+    q = q > 0 ? (q < steps ? q : steps) : 0;
+    return uint32_t(int64_t(q + 0.5)); // q fits int64, its conversion is cheaper
+  }
+  static inline float dequantize(uint32_t q, float min_v, float max_v, uint32_t nbits)
+  {
+    G_ASSERT(nbits > 0 && nbits <= 32);
+    return float(min_v + q * ((double(max_v) - min_v) / quantSteps(nbits)));
+  }
+  static inline uint64_t bswap64(uint64_t v)
+  {
+#if defined(_MSC_VER) && !defined(__clang__)
+    return _byteswap_uint64(v);
+#else
+    return __builtin_bswap64(v);
+#endif
+  }
+  static inline uint32_t clz64(uint64_t v) // undefined for 0
+  {
+#if defined(__GNUC__) || defined(__clang__)
+    return __builtin_clzll(v);
+#elif defined(_MSC_VER) && _TARGET_64BIT
+    unsigned long index;
+    _BitScanReverse64(&index, v);
+    return 63 - index;
+#else
+    uint32_t n = 0;
+    for (; !(v >> 63); v <<= 1)
+      n++;
+    return n;
+#endif
+  }
+  static inline uint64_t loadBE64(const uint8_t *p)
+  {
+    uint64_t v;
+    memcpy(&v, p, sizeof(v));
+#if defined(_TARGET_CPU_BE)
+    return v;
+#else
+    return bswap64(v);
+#endif
+  }
+  static inline void storeBE64(uint8_t *p, uint64_t v)
+  {
+#if !defined(_TARGET_CPU_BE)
+    v = bswap64(v);
+#endif
+    memcpy(p, &v, sizeof(v));
+  }
+  static inline uint32_t loadLE32(const uint8_t *p)
+  {
+    uint32_t v;
+    memcpy(&v, p, sizeof(v));
+#if defined(_TARGET_CPU_BE)
+    v = uint32_t(bswap64(v) >> 32);
+#endif
+    return v;
+  }
+  static inline void storeLE32(uint8_t *p, uint32_t v)
+  {
+#if defined(_TARGET_CPU_BE)
+    v = uint32_t(bswap64(v) >> 32);
+#endif
+    memcpy(p, &v, sizeof(v));
+  }
+  template <typename T>
+  static inline uint32_t svbEncode(T v)
+  {
+    if constexpr (eastl::is_signed_v<T>)
+      return (uint32_t(v) << 1) ^ uint32_t(v >> 31);
+    else
+      return v;
+  }
+  template <typename T>
+  static inline T svbDecode(uint32_t v)
+  {
+    return eastl::is_signed_v<T> ? T((v >> 1) ^ -(v & 1)) : T(v);
+  }
   static inline uint32_t bytes2bits(uint32_t by) { return by << 3; }
 
   uint32_t bitsUsed : 31;
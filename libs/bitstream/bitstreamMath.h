@@ -0,0 +1,239 @@
+//
+// Dagor Engine 6.5 - Game Libraries
+// Copyright (C) Gaijin Games KFT.  All rights reserved.
+//
+#pragma once
+
+#include <bitstream/bitstream.h>
+#include <math/dag_Point3.h>
+#include <math/dag_Quat.h>
+#include <math/dag_TMatrix.h>
+#include <math/dag_bounds3.h>
+
+// Compressed encodings of core math types. Plain Point3/Quat/TMatrix keep raw float layout of Write(const T &),
+// so compression is opt-in: wrappers below bind value with its precision and are written/read by write_type/read_type,
+// temporaries included:
+//
+//   bs.Write(danet::quat_smallest3(rot));          bs.Read(danet::quat_smallest3(rot));
+//   bs.Write(danet::quantized_pos(pos, mapBox));   bs.Read(danet::quantized_pos(pos, mapBox));
+//
+// Both sides must use same parameters. Error bounds are given for default precision. Failed read leaves value
+// unspecified, readers of bitstreamReader.h zero it with reset_type(). Writing is templated on stream, so encodings
+// go to SegmentedBitStream as well.
+
+namespace danet
+{
+/// Unit vector in octahedral encoding, 2*bits bits. Max angular error is about 0.06 degrees at 12 bits,
+/// 0.96 at 8 bits. Input does not need to be normalized (zero vector is read as +Z), result is normalized.
+template <typename V>
+struct UnitVectorRef
+{
+  V &v;
+  uint32_t bits;
+};
+inline UnitVectorRef<const Point3> unit_vector(const Point3 &v, uint32_t bits = 12) { return {v, bits}; }
+inline UnitVectorRef<Point3> unit_vector(Point3 &v, uint32_t bits = 12) { return {v, bits}; }
+
+/// Rotation quaternion in smallest three encoding: index of largest component and other three, 2+3*bits bits.
+/// Max rotation error is about 0.24 degrees at 10 bits, 0.06 at 12 bits. Input does not need to be normalized,
+/// result is normalized and may be negated (same rotation).
+template <typename Q>
+struct QuatSmallest3Ref
+{
+  Q &q;
+  uint32_t bits;
+};
+inline QuatSmallest3Ref<const Quat> quat_smallest3(const Quat &q, uint32_t bits = 10) { return {q, bits}; }
+inline QuatSmallest3Ref<Quat> quat_smallest3(Quat &q, uint32_t bits = 10) { return {q, bits}; }
+
+/// Position inside bounds, bits per axis (3*bits bits). Max error per axis is box size / (2^(bits+1) - 2),
+/// e.g. 0.4 mm for 50 m box at 16 bits; positions outside are clamped to box.
+template <typename P>
+struct QuantizedPosRef
+{
+  P &p;
+  const BBox3 &bounds;
+  uint32_t bits;
+};
+inline QuantizedPosRef<const Point3> quantized_pos(const Point3 &p, const BBox3 &bounds, uint32_t bits = 16)
+{
+  return {p, bounds, bits};
+}
+inline QuantizedPosRef<Point3> quantized_pos(Point3 &p, const BBox3 &bounds, uint32_t bits = 16) { return {p, bounds, bits}; }
+
+/// Transform as smallest three rotation and quantized translation (see above), 1+2+3*rot_bits+3*pos_bits bits;
+/// non-unit or mirroring scale adds 48 bits of half floats (relative error 0.05%). Shear is not preserved.
+template <typename M>
+struct CompressedTmRef
+{
+  M &tm;
+  const BBox3 &bounds;
+  uint32_t rotBits, posBits;
+};
+inline CompressedTmRef<const TMatrix> compressed_tm(const TMatrix &tm, const BBox3 &bounds, uint32_t rot_bits = 10,
+  uint32_t pos_bits = 16)
+{
+  return {tm, bounds, rot_bits, pos_bits};
+}
+inline CompressedTmRef<TMatrix> compressed_tm(TMatrix &tm, const BBox3 &bounds, uint32_t rot_bits = 10, uint32_t pos_bits = 16)
+{
+  return {tm, bounds, rot_bits, pos_bits};
+}
+
+
+namespace internal
+{
+inline float sign_not_zero(float v) { return v < 0 ? -1.f : 1.f; }
+
+// folds lower hemisphere of octahedron over upper one (same transform unfolds it)
+inline void oct_wrap(float &u, float &v)
+{
+  float ou = (1 - fabsf(v)) * sign_not_zero(u), ov = (1 - fabsf(u)) * sign_not_zero(v);
+  u = ou;
+  v = ov;
+}
+
+// quaternion of proper orthonormal matrix, from its largest diagonal term (Quat(const TMatrix &) fits 16 sign combinations)
+inline Quat rotation_to_quat(const TMatrix &r)
+{
+  const float(&m)[4][3] = r.m; // m[col][row]
+  float trace = m[0][0] + m[1][1] + m[2][2];
+  if (trace > 0)
+  {
+    float s = 0.5f / sqrtf(trace + 1);
+    return Quat((m[1][2] - m[2][1]) * s, (m[2][0] - m[0][2]) * s, (m[0][1] - m[1][0]) * s, 0.25f / s);
+  }
+  if (m[0][0] > m[1][1] && m[0][0] > m[2][2])
+  {
+    float s = 0.5f / sqrtf(1 + m[0][0] - m[1][1] - m[2][2]);
+    return Quat(0.25f / s, (m[1][0] + m[0][1]) * s, (m[2][0] + m[0][2]) * s, (m[1][2] - m[2][1]) * s);
+  }
+  if (m[1][1] > m[2][2])
+  {
+    float s = 0.5f / sqrtf(1 + m[1][1] - m[0][0] - m[2][2]);
+    return Quat((m[1][0] + m[0][1]) * s, 0.25f / s, (m[2][1] + m[1][2]) * s, (m[2][0] - m[0][2]) * s);
+  }
+  float s = 0.5f / sqrtf(1 + m[2][2] - m[0][0] - m[1][1]);
+  return Quat((m[2][0] + m[0][2]) * s, (m[2][1] + m[1][2]) * s, 0.25f / s, (m[0][1] - m[1][0]) * s);
+}
+} // namespace internal
+
+template <typename Stream, typename V>
+inline void write_type(Stream &bs, const UnitVectorRef<V> &w)
+{
+  const Point3 &n = w.v;
+  float l1 = fabsf(n.x) + fabsf(n.y) + fabsf(n.z);
+  float u = l1 > 0 ? n.x / l1 : 0, v = l1 > 0 ? n.y / l1 : 0;
+  if (n.z < 0)
+    internal::oct_wrap(u, v);
+  bs.WriteQuantized(u, -1.f, 1.f, w.bits);
+  bs.WriteQuantized(v, -1.f, 1.f, w.bits);
+}
+inline bool read_type(const BitStream &bs, const UnitVectorRef<Point3> &w)
+{
+  float u = 0, v = 0;
+  if (!bs.ReadQuantized(u, -1.f, 1.f, w.bits) || !bs.ReadQuantized(v, -1.f, 1.f, w.bits))
+    return false;
+  float z = 1 - fabsf(u) - fabsf(v);
+  if (z < 0)
+    internal::oct_wrap(u, v);
+  w.v = normalize(Point3(u, v, z));
+  return true;
+}
+inline void reset_type(const UnitVectorRef<Point3> &w) { w.v = Point3(0, 0, 0); }
+
+template <typename Stream, typename Q>
+inline void write_type(Stream &bs, const QuatSmallest3Ref<Q> &w)
+{
+  const Quat &q = w.q;
+  uint32_t largest = 0;
+  for (uint32_t i = 1; i < 4; ++i)
+    if (fabsf(q[i]) > fabsf(q[largest]))
+      largest = i;
+  float len = sqrtf(q.x * q.x + q.y * q.y + q.z * q.z + q.w * q.w);
+  float scale = len > 0 ? internal::sign_not_zero(q[largest]) / len : 0; // largest one is sent as positive
+  bs.WriteBitsValue(largest, 2);
+  for (uint32_t i = 0; i < 4; ++i)
+    if (i != largest)
+      bs.WriteQuantized(q[i] * scale, -float(M_SQRT1_2), float(M_SQRT1_2), w.bits);
+}
+inline bool read_type(const BitStream &bs, const QuatSmallest3Ref<Quat> &w)
+{
+  uint32_t largest = 0;
+  if (!bs.ReadBitsValue(largest, 2))
+    return false;
+  Quat q(0, 0, 0, 0);
+  float sumSq = 0;
+  for (uint32_t i = 0; i < 4; ++i)
+    if (i != largest)
+    {
+      if (!bs.ReadQuantized(q[i], -float(M_SQRT1_2), float(M_SQRT1_2), w.bits))
+        return false;
+      sumSq += q[i] * q[i];
+    }
+  q[largest] = sqrtf(max(1.f - sumSq, 0.f));
+  w.q = normalize(q);
+  return true;
+}
+inline void reset_type(const QuatSmallest3Ref<Quat> &w) { w.q = Quat(0, 0, 0, 0); }
+
+template <typename Stream, typename P>
+inline void write_type(Stream &bs, const QuantizedPosRef<P> &w)
+{
+  for (int i = 0; i < 3; ++i)
+    bs.WriteQuantized(w.p[i], w.bounds.lim[0][i], w.bounds.lim[1][i], w.bits);
+}
+inline bool read_type(const BitStream &bs, const QuantizedPosRef<Point3> &w)
+{
+  Point3 p;
+  for (int i = 0; i < 3; ++i)
+    if (!bs.ReadQuantized(p[i], w.bounds.lim[0][i], w.bounds.lim[1][i], w.bits))
+      return false;
+  w.p = p;
+  return true;
+}
+inline void reset_type(const QuantizedPosRef<Point3> &w) { w.p = Point3(0, 0, 0); }
+
+template <typename Stream, typename M>
+inline void write_type(Stream &bs, const CompressedTmRef<M> &w)
+{
+  const TMatrix &tm = w.tm;
+  Point3 scale(length(tm.getcol(0)), length(tm.getcol(1)), length(tm.getcol(2)));
+  if (tm.det() < 0) // mirroring goes to scale, so rotation stays proper
+    scale.x = -scale.x;
+  TMatrix rot = TMatrix::IDENT;
+  for (int i = 0; i < 3; ++i)
+    rot.setcol(i, scale[i] != 0 ? tm.getcol(i) / scale[i] : rot.getcol(i));
+
+  const float SCALE_EPS = 1e-4f;
+  bool hasScale = fabsf(scale.x - 1) > SCALE_EPS || fabsf(scale.y - 1) > SCALE_EPS || fabsf(scale.z - 1) > SCALE_EPS;
+  bs.Write(hasScale);
+  if (hasScale)
+    for (int i = 0; i < 3; ++i)
+      bs.WriteHalf(scale[i]);
+  Quat q = internal::rotation_to_quat(rot);
+  write_type(bs, quat_smallest3(q, w.rotBits));
+  write_type(bs, quantized_pos(tm.getcol(3), w.bounds, w.posBits));
+}
+inline bool read_type(const BitStream &bs, const CompressedTmRef<TMatrix> &w)
+{
+  bool hasScale = false;
+  Point3 scale(1, 1, 1), pos;
+  Quat q;
+  if (!bs.Read(hasScale))
+    return false;
+  if (hasScale)
+    for (int i = 0; i < 3; ++i)
+      if (!bs.ReadHalf(scale[i]))
+        return false;
+  if (!read_type(bs, quat_smallest3(q, w.rotBits)) || !read_type(bs, quantized_pos(pos, w.bounds, w.posBits)))
+    return false;
+  TMatrix tm = makeTM(q);
+  for (int i = 0; i < 3; ++i)
+    tm.setcol(i, tm.getcol(i) * scale[i]);
+  tm.setcol(3, pos);
+  w.tm = tm;
+  return true;
+}
+inline void reset_type(const CompressedTmRef<TMatrix> &w) { w.tm.zero(); }
+}; // namespace danet
@@ -0,0 +1,249 @@
+//
+// Dagor Engine 6.5 - Game Libraries
+// Copyright (C) Gaijin Games KFT.  All rights reserved.
+//
+#pragma once
+
+#include <bitstream/bitstream.h>
+
+// Readers which don't report failure per field: reads return nothing, failed one zeroes its destination and sets
+// error flag, which stays set, so message is checked once at the end instead of every Read() call. Destinations
+// which can't be value-initialized (e.g. wrappers of bitstreamMath.h) are zeroed by reset_type(t) found by ADL.
+//
+// StickyReader checks every read. After failure read offset is moved to end of stream, so all following reads fail
+// (and give zeros) as well, and decoding needs no early exits:
+//
+//   danet::StickyReader r(bs);
+//   r.ReadCompressed(id);
+//   r.Read(alive);
+//   r.Read(name);
+//   return r.IsOk();
+//
+// ValidatedReader is for messages of fixed layout: stream size is checked once for all fields of known size, which
+// are then read with no checks or branches, only declared size left is counted. Failed Require() switches these reads
+// to block of zeros, so caller that skips the check still reads in bounds. Reading past declared size is caller error:
+// it is asserted in debug build, in release one it is not checked but makes IsOk() false. Other reads (VLQ, strings,
+// containers, read_type encodings) are checked as above:
+//
+//   danet::ValidatedReader r(bs, 32 + 1 + 3 * 20); // id, alive flag, quantized position
+//   if (!r)
+//     return false;
+//   r.Read(id);
+//   r.Read(alive);
+//   for (float &p : pos)
+//     r.ReadQuantized(p, -4096.f, 4096.f, 20);
+//   r.ReadCompressed(count);        // variable-length part
+//   if (r.Require(count * 16))      // fields of size known only now
+//     ...
+//   return r.IsOk();
+//
+// Fields are read from stream at its read offset. ValidatedReader keeps its own copy of it, which is stored back
+// by checked reads and when reader is destroyed. After failure of any read or Require() both readers give only zeros
+// and read offset is at end of stream.
+
+namespace danet
+{
+namespace internal
+{
+template <typename T, typename = void>
+struct SupportsResetType : eastl::false_type
+{};
+template <typename T>
+struct SupportsResetType<T, eastl::void_t<decltype(reset_type(eastl::declval<T &>()))>> : eastl::true_type
+{};
+
+// fields of known size up to this are read from zeros after failure of ValidatedReader
+static constexpr uint32_t MAX_FIELD_BYTES = 64;
+alignas(16) inline const uint8_t zero_field_bytes[MAX_FIELD_BYTES] = {};
+
+// reads of fields with known size are checked when 'checked', otherwise they rely on declared size (see ValidatedReader)
+template <bool checked>
+class BitReader
+{
+public:
+  explicit operator bool() const { return IsOk(); }
+  bool IsOk() const { return !error && (checked || uint64_t(offset) + declaredLeft <= bs.bitsUsed); }
+
+  // fields of known size, same encoding as BitStream ones
+  void ReadBits(uint8_t *output, uint32_t bits)
+  {
+    if constexpr (checked)
+    {
+      if (!take(bits))
+        memset(output, 0, (bits + 7) >> 3);
+      else if (bits)
+        bs.readBitsNoCheck(output, bits);
+    }
+    else if (bits > MAX_FIELD_BYTES * CHAR_BIT && error) // longer than zeros
+      memset(output, 0, (bits + 7) >> 3);
+    else
+    {
+      uint32_t at = declared(bits);
+      BitStream::readBitsNoCheck(data, dataBits, at, output, bits);
+    }
+  }
+  void Read(bool &v) { v = readWord(1) != 0; }
+  template <typename T>
+  void ReadBitsValue(T &v, uint32_t nbits)
+  {
+    static_assert(eastl::is_integral_v<T> || eastl::is_enum_v<T>);
+    G_ASSERT(nbits <= sizeof(T) * CHAR_BIT);
+    v = BitStream::bitsToValue<T>(readWord(nbits), nbits);
+  }
+  template <uint32_t nbits, typename T>
+  void ReadBitsValue(T &v)
+  {
+    static_assert(nbits > 0 && nbits <= sizeof(T) * CHAR_BIT);
+    ReadBitsValue(v, nbits);
+  }
+  void ReadRanged(int &v, int min_v, int max_v)
+  {
+    v = BitStream::bitsToRanged(uint32_t(readWord(BitStream::rangedBits(min_v, max_v))), min_v, max_v);
+  }
+  void ReadQuantized(float &v, float min_v, float max_v, uint32_t nbits)
+  {
+    v = BitStream::dequantize(uint32_t(readWord(nbits)), min_v, max_v, nbits);
+  }
+  void ReadHalf(float &v)
+  {
+    uint16_t h = 0;
+    ReadBitsValue(h, 16);
+    v = half_to_float(h);
+  }
+
+  // plain values and arrays of them are fields of known size, other types are always checked
+  template <typename T>
+  void Read(T &t)
+  {
+    if constexpr (is_raw_element_v<eastl::remove_all_extents_t<T>>)
+    {
+      static_assert(!eastl::is_const_v<T>);
+      ReadBits((uint8_t *)&t, sizeof(T) * CHAR_BIT);
+    }
+    else
+      check(stream().Read(t), t);
+  }
+  template <typename T>
+  eastl::enable_if_t<!eastl::is_lvalue_reference_v<T>> Read(T &&t)
+  {
+    check(stream().Read(eastl::move(t)), t);
+  }
+  template <typename T>
+  void ReadCompressed(T &v)
+  {
+    check(stream().ReadCompressed(v), v);
+  }
+
+  BitReader(const BitReader &) = delete;
+  BitReader &operator=(const BitReader &) = delete;
+
+protected:
+  BitReader(const BitStream &bs) : bs(bs), data(bs.data), dataBits(bs.bitsAllocated), offset(bs.readOffset) {}
+  ~BitReader()
+  {
+    if (!checked && !error)
+      bs.readOffset = offset;
+  }
+
+  // declares fields of given size following already declared ones, fails if stream is shorter;
+  // reading fields not covered by successful Require() is caller error (see ValidatedReader)
+  bool Require(uint32_t bits)
+  {
+    if (error || uint64_t(offset) + declaredLeft + bits > bs.bitsUsed)
+    {
+      fail();
+      return false;
+    }
+    declaredLeft += bits;
+    return true;
+  }
+
+  bool take(uint32_t bits)
+  {
+    if (DAGOR_LIKELY(bits <= bs.bitsUsed - bs.readOffset))
+      return true;
+    fail();
+    return false;
+  }
+
+  // offset of declared field in 'data', start of zeros after failure
+  uint32_t declared(uint32_t bits)
+  {
+    G_ASSERTF(error || bits <= declaredLeft, "%u bits read, %u left in declared layout", bits, declaredLeft);
+    declaredLeft -= bits;
+    uint32_t at = offset & offsetMask;
+    offset += bits;
+    return at;
+  }
+
+  // field of up to 64 bits
+  uint64_t readWord(uint32_t n)
+  {
+    if constexpr (checked)
+      return take(n) && n ? bs.readBitsWord(n) : 0;
+    else
+    {
+      uint32_t at = declared(n);
+      return n ? BitStream::readBitsWord(data, dataBits, at, n) : 0;
+    }
+  }
+
+  // stream at reader's offset for checked reads
+  const BitStream &stream()
+  {
+    if (!checked && !error)
+      bs.readOffset = offset;
+    return bs;
+  }
+
+  // checked reads must leave declared fields in stream (checked reader has none)
+  template <typename T>
+  void check(bool ok, T &t)
+  {
+    if (DAGOR_LIKELY(ok && !error && (checked || uint64_t(bs.readOffset) + declaredLeft <= bs.bitsUsed)))
+    {
+      offset = bs.readOffset;
+      return;
+    }
+    fail();
+    if constexpr (SupportsResetType<T>::value)
+      reset_type(t);
+    else if constexpr (eastl::is_default_constructible_v<T> && eastl::is_move_assignable_v<T>)
+      t = T();
+  }
+
+  // all following reads fail, declared fields included
+  void fail()
+  {
+    error = true;
+    declaredLeft = 0;
+    bs.readOffset = bs.bitsUsed;
+    data = zero_field_bytes;
+    dataBits = MAX_FIELD_BYTES * CHAR_BIT;
+    offsetMask = 0;
+  }
+
+  const BitStream &bs;
+  const uint8_t *data; // declared fields are read from here at offset & offsetMask: stream, or zeros after failure
+  uint32_t dataBits;
+  uint32_t offset; // read offset of unchecked reader in stream
+  uint32_t offsetMask = ~0u;
+  uint32_t declaredLeft = 0;
+  bool error = false;
+};
+} // namespace internal
+
+class StickyReader : public internal::BitReader<true>
+{
+public:
+  explicit StickyReader(const BitStream &bs) : BitReader(bs) {}
+};
+
+class ValidatedReader : public internal::BitReader<false>
+{
+public:
+  ValidatedReader(const BitStream &bs, uint32_t fixed_bits) : BitReader(bs) { Require(fixed_bits); }
+
+  using BitReader::Require;
+};
+}; // namespace danet
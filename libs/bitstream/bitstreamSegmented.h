@@ -0,0 +1,265 @@
+//
+// Dagor Engine 6.5 - Game Libraries
+// Copyright (C) Gaijin Games KFT.  All rights reserved.
+//
+#pragma once
+
+#include <bitstream/bitstream.h>
+#include <generic/dag_tab.h>
+
+// Write-only bit stream stored in chain of fixed size chunks, for large streams (e.g. snapshots) which would be
+// reallocated and copied many times by BitStream growth. Encoding is same as BitStream one, bits go on continuously
+// across chunk boundaries, so written data is read back by BitStream from concatenated chunks:
+//
+//   danet::BitStreamChunkPool pool;              // chunks are reused by next streams
+//   danet::SegmentedBitStream snapshot(pool);
+//   snapshot.Write(...);
+//   Tab<dag::ConstSpan<uint8_t>> segments;
+//   snapshot.GetSegments(segments);              // gather list for socket or file output, no copy
+//   dag::ConstSpan<uint8_t> data = snapshot.Linearize(); // copies only when there is more than one chunk
+
+namespace danet
+{
+/// Free list of fixed size chunks for SegmentedBitStream. Streams return their chunks on Clear() or destruction,
+/// they must be destroyed before pool. Not thread safe.
+class BitStreamChunkPool
+{
+public:
+  BitStreamChunkPool(uint32_t chunk_bytes = 64 << 10, IMemAlloc *a = defaultmem) : chunkSize(chunk_bytes), allocator(a)
+  {
+    G_ASSERT(chunk_bytes >= 8 && !(chunk_bytes & 7)); // stream stores 64-bit words, they never cross chunks
+  }
+  BitStreamChunkPool(const BitStreamChunkPool &) = delete;
+  BitStreamChunkPool &operator=(const BitStreamChunkPool &) = delete;
+  ~BitStreamChunkPool() { trim(); }
+
+  uint32_t getChunkSize() const { return chunkSize; }
+  IMemAlloc *getAllocator() const { return allocator; }
+
+  uint8_t *allocChunk()
+  {
+    uint8_t *chunk = freeHead;
+    if (!chunk)
+      return (uint8_t *)allocator->alloc(chunkSize);
+    memcpy(&freeHead, chunk, sizeof(freeHead));
+    return chunk;
+  }
+  void freeChunk(uint8_t *chunk)
+  {
+    memcpy(chunk, &freeHead, sizeof(freeHead)); // free chunks are linked through their first bytes
+    freeHead = chunk;
+  }
+  // releases cached free chunks
+  void trim()
+  {
+    while (uint8_t *chunk = freeHead)
+    {
+      memcpy(&freeHead, chunk, sizeof(freeHead));
+      allocator->free(chunk);
+    }
+  }
+
+private:
+  uint32_t chunkSize;
+  uint8_t *freeHead = nullptr;
+  IMemAlloc *allocator;
+};
+
+class SegmentedBitStream
+{
+public:
+  explicit SegmentedBitStream(BitStreamChunkPool &p) : pool(p), chunkSize(p.getChunkSize())
+  {
+    dag::set_allocator(chunks, p.getAllocator());
+    dag::set_allocator(linear, p.getAllocator());
+    chunks.push_back(pool.allocChunk());
+  }
+  SegmentedBitStream(const SegmentedBitStream &) = delete;
+  SegmentedBitStream &operator=(const SegmentedBitStream &) = delete;
+  ~SegmentedBitStream()
+  {
+    for (uint8_t *chunk : chunks)
+      pool.freeChunk(chunk);
+  }
+
+  // first chunk and linearization buffer are kept
+  void Clear()
+  {
+    for (uint32_t i = 1; i < chunks.size(); ++i)
+      pool.freeChunk(chunks[i]);
+    chunks.resize(1);
+    chunkPos = accBits = 0;
+    acc = 0;
+  }
+
+  uint32_t GetNumberOfBitsUsed() const { return (uint32_t(chunks.size() - 1) * chunkSize + chunkPos) * 8 + accBits; }
+  uint32_t GetNumberOfBytesUsed() const { return (GetNumberOfBitsUsed() + 7) >> 3; }
+
+  // writes below have same encoding as BitStream ones
+  void WriteBits(const uint8_t *input, uint32_t bits)
+  {
+    uint32_t bytes = bits >> 3, tailBits = bits & 7;
+    if (!accBits) // word aligned: whole words are copied to chunks
+      for (uint32_t cnt; bytes >= 8; input += cnt, bytes -= cnt)
+      {
+        cnt = min(bytes & ~7u, chunkSize - chunkPos);
+        memcpy(chunks.back() + chunkPos, input, cnt);
+        chunkPos += cnt;
+        if (chunkPos == chunkSize)
+          nextChunk();
+      }
+    for (; bytes >= 8; bytes -= 8, input += 8)
+      writeBitsWord(BitStream::loadBE64(input), 64);
+    for (; bytes; bytes--)
+      writeBitsWord(*input++, 8);
+    if (tailBits)
+      writeBitsWord(*input, tailBits);
+  }
+  void WriteAlignedBytes(const uint8_t *input, uint32_t bytesLen)
+  {
+    AlignWriteToByteBoundary();
+    WriteBits(input, bytesLen * 8);
+  }
+  void AlignWriteToByteBoundary()
+  {
+    if (accBits & 7)
+      writeBitsWord(0, 8 - (accBits & 7));
+  }
+
+  void Write0() { writeBitsWord(0, 1); }
+  void Write1() { writeBitsWord(1, 1); }
+  void Write(bool v) { writeBitsWord(v ? 1 : 0, 1); }
+  // plain values and arrays of them
+  template <typename T>
+  eastl::enable_if_t<internal::is_raw_element_v<eastl::remove_all_extents_t<T>>> Write(const T &t)
+  {
+    WriteBits((const uint8_t *)&t, sizeof(T) * CHAR_BIT);
+  }
+
+  void WriteBitsValue(uint64_t v, uint32_t nbits)
+  {
+    G_ASSERT(nbits <= 64);
+    if (nbits)
+      writeBitsWord(v, nbits);
+  }
+  template <uint32_t nbits, typename T>
+  void WriteBitsValue(T v)
+  {
+    static_assert((eastl::is_integral_v<T> || eastl::is_enum_v<T>) && nbits > 0 && nbits <= sizeof(T) * CHAR_BIT);
+    writeBitsWord((uint64_t)v, nbits);
+  }
+  void WriteRanged(int v, int min_v, int max_v)
+  {
+    WriteBitsValue(BitStream::rangedToBits(v, min_v, max_v), BitStream::rangedBits(min_v, max_v));
+  }
+  void WriteQuantized(float v, float min_v, float max_v, uint32_t nbits)
+  {
+    writeBitsWord(BitStream::quantize(v, min_v, max_v, nbits), nbits);
+  }
+  void WriteHalf(float v) { writeBitsWord(float_to_half(v), 16); }
+
+  void WriteCompressed(int16_t v) { WriteCompressed(uint16_t((uint16_t(v) << 1) ^ uint16_t(v >> 15))); }
+  void WriteCompressed(int32_t v) { WriteCompressed((uint32_t(v) << 1) ^ uint32_t(v >> 31)); }
+  void WriteCompressed(int64_t v) { WriteCompressed((uint64_t(v) << 1) ^ uint64_t(v >> 63)); }
+  void WriteCompressed(uint16_t v) { writeCompressed(v); }
+  void WriteCompressed(uint32_t v) { writeCompressed(v); }
+  void WriteCompressed(uint64_t v) { writeCompressed(v); }
+
+  void Write(const char *t) { writeString(t, (t && *t) ? strlen(t) : size_t(0)); }
+  template <typename T>
+  typename eastl::enable_if<internal::IsString<T>::value>::type Write(const T &str)
+  {
+    writeString(str.c_str(), (size_t)str.length());
+  }
+  // types with write_type() for this stream, e.g. encodings of bitstreamMath.h
+  template <typename T>
+  eastl::enable_if_t<internal::supports_write_type<T, SegmentedBitStream>::value> Write(const T &t)
+  {
+    write_type(*this, t);
+  }
+
+  // Written data as chunk pieces in order (all but last are of chunk size), valid until next write.
+  void GetSegments(Tab<dag::ConstSpan<uint8_t>> &segments) const
+  {
+    storeTail();
+    uint32_t lastBytes = chunkPos + ((accBits + 7) >> 3);
+    segments.clear();
+    for (uint32_t i = 0; i + 1 < chunks.size(); ++i)
+      segments.push_back(dag::ConstSpan<uint8_t>(chunks[i], chunkSize));
+    if (lastBytes)
+      segments.push_back(dag::ConstSpan<uint8_t>(chunks.back(), lastBytes));
+  }
+  // Written data in one piece, valid until next write. It is first chunk itself when it holds everything,
+  // otherwise chunks are copied to separate buffer.
+  dag::ConstSpan<uint8_t> Linearize()
+  {
+    storeTail();
+    uint32_t bytes = GetNumberOfBytesUsed();
+    if (chunks.size() == 1)
+      return dag::ConstSpan<uint8_t>(chunks[0], bytes);
+    linear.resize(bytes);
+    for (uint32_t i = 0, pos = 0; pos < bytes; ++i, pos += chunkSize)
+      memcpy(linear.data() + pos, chunks[i], min(chunkSize, bytes - pos));
+    return make_span_const(linear);
+  }
+
+private:
+  // Writes low n bits of v (1..64), MSB first. Bits are collected in 64-bit word, which is stored to chunk when full.
+  void writeBitsWord(uint64_t v, uint32_t n)
+  {
+    v &= ~uint64_t(0) >> (64 - n);
+    uint32_t end = accBits + n;
+    if (end < 64)
+    {
+      acc |= v << (64 - end);
+      accBits = end;
+      return;
+    }
+    accBits = end - 64; // bits going to next word
+    BitStream::storeBE64(chunks.back() + chunkPos, acc | (v >> accBits));
+    acc = accBits ? v << (64 - accBits) : 0;
+    chunkPos += 8;
+    if (DAGOR_UNLIKELY(chunkPos == chunkSize))
+      nextChunk();
+  }
+
+  // last chunk always has room for word being collected
+  void nextChunk()
+  {
+    chunks.push_back(pool.allocChunk());
+    chunkPos = 0;
+  }
+
+  // partial word goes to its place in chunk, so chunks hold all written bits
+  void storeTail() const
+  {
+    if (accBits)
+      BitStream::storeBE64(chunks.back() + chunkPos, acc);
+  }
+
+  template <typename T>
+  void writeCompressed(T v)
+  {
+    uint64_t x = v;
+    uint32_t n = BitStream::vlqBytes(x, (sizeof(T) * CHAR_BIT + 6) / 7);
+    writeBitsWord(BitStream::vlqWord(x, n), min(n, 8u) * 8);
+    if (n > 8) // 64-bit values only
+      writeBitsWord(BitStream::vlqWord(x >> 56, n - 8), (n - 8) * 8);
+  }
+
+  void writeString(const char *str, size_t str_len)
+  {
+    G_ASSERT(uint32_t(str_len) == str_len);
+    WriteCompressed((uint32_t)str_len);
+    WriteBits((const uint8_t *)str, uint32_t(str_len) * 8);
+  }
+
+  BitStreamChunkPool &pool;
+  uint32_t chunkSize;
+  uint32_t chunkPos = 0; // bytes of whole words in last chunk
+  uint32_t accBits = 0;
+  uint64_t acc = 0; // bits of next word, from MSB
+  Tab<uint8_t *> chunks;
+  Tab<uint8_t> linear;
+};
+}; // namespace danet
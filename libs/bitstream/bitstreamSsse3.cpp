@@ -0,0 +1,39 @@
+// Copyright (C) Gaijin Games KFT.  All rights reserved.
+
+// Only this file is compiled with SSSE3 enabled (DAGUTILS_SSSE3 in CMakeLists.txt), its code runs on CPUs that have it.
+
+// MSVC compiles SSSE3 intrinsics without target flags and defines no macro for them, other compilers need -mssse3
+#if defined(_MSC_VER) && !defined(__clang__)
+#define BITSTREAM_SIMD_SSSE3 1
+#include <intrin.h>
+#elif !defined(__SSSE3__)
+#error This file must be compiled with -mssse3
+#endif
+#include <bitstream/bitstream.h>
+
+namespace danet
+{
+namespace internal
+{
+static bool cpu_has_ssse3()
+{
+#if defined(_MSC_VER) && !defined(__clang__)
+  int info[4];
+  __cpuid(info, 1);
+  return (info[2] >> 9) & 1;
+#else
+  __builtin_cpu_init(); // may run before its own static initializer
+  return __builtin_cpu_supports("ssse3");
+#endif
+}
+
+extern const bool svb_ssse3_supported = cpu_has_ssse3();
+
+uint32_t svb_decode_ssse3_dispatch(const uint8_t *ctrl, const uint8_t *&src, const uint8_t *load_end, uint32_t *values,
+  uint32_t count, bool zigzag)
+{
+  return zigzag ? svb_decode_ssse3<true>(ctrl, src, load_end, values, count)
+                : svb_decode_ssse3<false>(ctrl, src, load_end, values, count);
+}
+} // namespace internal
+}; // namespace danet
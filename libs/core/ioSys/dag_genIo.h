@@ -0,0 +1,88 @@
+//
+// Dagor Engine 6.5
+// Copyright (C) Gaijin Games KFT.  All rights reserved.
+//
+#pragma once
+
+#include <stdio.h>
+#include <string.h>
+
+/// @addtogroup utility_classes
+/// @{
+
+/// @addtogroup serialization
+/// @{
+
+
+/// @file
+/// Generic output stream interface and basic implementations.
+
+
+/// Abstract sequential output stream.
+/// Writers push data straight into the sink, no intermediate buffering is done at this level.
+class GeneralSaveCB
+{
+public:
+  virtual ~GeneralSaveCB() {}
+
+  /// Write @b size bytes from @b ptr to the stream.
+  virtual void write(const void *ptr, int size) = 0;
+
+  /// Returns number of bytes written so far.
+  virtual int tell() = 0;
+
+  /// Helper to write zero-terminated string (without terminator).
+  void writeStr(const char *s)
+  {
+    if (s && *s)
+      write(s, (int)strlen(s));
+  }
+};
+
+
+/// Output stream that writes to C FILE (file is not closed by this object).
+class FileGeneralSaveCB : public GeneralSaveCB
+{
+public:
+  FileGeneralSaveCB(FILE *f) : fp(f), written(0) {}
+
+  void write(const void *ptr, int size) override
+  {
+    if (size > 0 && fwrite(ptr, size, 1, fp) == 1)
+      written += size;
+  }
+  int tell() override { return written; }
+
+protected:
+  FILE *fp;
+  int written;
+};
+
+
+/// Output stream that forwards data to user-supplied callback.
+/// Data pointer passed to callback is valid only during the call.
+class CallbackGeneralSaveCB : public GeneralSaveCB
+{
+public:
+  typedef void (*write_cb_t)(void *ctx, const void *ptr, int size);
+
+  CallbackGeneralSaveCB(write_cb_t cb, void *cb_ctx) : writeCb(cb), ctx(cb_ctx), written(0) {}
+
+  void write(const void *ptr, int size) override
+  {
+    if (size <= 0)
+      return;
+    writeCb(ctx, ptr, size);
+    written += size;
+  }
+  int tell() override { return written; }
+
+protected:
+  write_cb_t writeCb;
+  void *ctx;
+  int written;
+};
+
+/// @}
+
+/// @}
@@ -0,0 +1,69 @@
+//
+// Dagor Engine 6.5
+// Copyright (C) Gaijin Games KFT.  All rights reserved.
+//
+#pragma once
+
+#include <ioSys/dag_genIo.h>
+#include <generic/dag_tab.h>
+#include <memory/dag_mem.h>
+
+/// @addtogroup utility_classes
+/// @{
+
+/// @addtogroup serialization
+/// @{
+
+
+/// Output stream that writes to growable memory buffer.
+/// Buffer grows geometrically, written data is never copied except on buffer reallocation.
+class DynamicMemGeneralSaveCB : public GeneralSaveCB
+{
+public:
+  DynamicMemGeneralSaveCB(IMemAlloc *m = tmpmem, int reserve_sz = 0) : buf(m)
+  {
+    if (reserve_sz > 0)
+      buf.reserve(reserve_sz);
+  }
+
+  void write(const void *ptr, int size) override
+  {
+    if (size <= 0)
+      return;
+    uint32_t at = buf.size();
+    buf.resize_noinit(at + size);
+    memcpy(buf.data() + at, ptr, size);
+  }
+  int tell() override { return buf.size(); }
+
+  /// Returns pointer to written data (not zero-terminated).
+  const char *data() const { return buf.data(); }
+  char *data() { return buf.data(); }
+  /// Returns size of written data.
+  int size() const { return buf.size(); }
+
+  /// Discard written data, but keep allocated memory for reuse.
+  void reset() { buf.clear(); }
+
+  /// Moves written data to @b out (without copying) and resets stream.
+  void takeData(Tab<char> &out)
+  {
+    out.clear();
+    out.swap(buf);
+  }
+
+  /// Appends zero terminator (not accounted in size()) so data() can be used as C string.
+  const char *c_str()
+  {
+    buf.push_back('\0');
+    buf.pop_back();
+    return buf.data();
+  }
+
+protected:
+  Tab<char> buf;
+};
+
+/// @}
+
+/// @}
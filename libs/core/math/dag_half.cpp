@@ -0,0 +1,63 @@
+// Copyright (C) Gaijin Games KFT.  All rights reserved.
+
+#include <string.h>
+#include <math/dag_half.h>
+
+static inline uint32_t f2u(float f)
+{
+  uint32_t u;
+  memcpy(&u, &f, sizeof(u));
+  return u;
+}
+static inline float u2f(uint32_t u)
+{
+  float f;
+  memcpy(&f, &u, sizeof(f));
+  return f;
+}
+
+// round to nearest even, overflow goes to Inf, NaN stays (quiet) NaN, denormals are kept
+// (see https://gist.github.com/rygorous/2156668, float_to_half_fast3_rtne)
+uint16_t half_from_float(uint32_t f)
+{
+  const uint32_t f32infty = 255u << 23;
+  const uint32_t f16overflow = (127u + 16) << 23;
+  const uint32_t denormMagic = ((127u - 15) + (23 - 10) + 1) << 23;
+
+  uint32_t sign = f & 0x80000000u;
+  f ^= sign;
+  uint16_t o;
+  if (f >= f16overflow)
+    o = f > f32infty ? 0x7e00 : 0x7c00;
+  else if (f < (113u << 23)) // result is denormal or zero: let FPU do rounding by adding magic value
+    o = uint16_t(f2u(u2f(f) + u2f(denormMagic)) - denormMagic);
+  else
+  {
+    uint32_t mantOdd = (f >> 13) & 1;
+    f += ((15u - 127) << 23) + 0xfff; // rebias exponent and round, ties go up here...
+    f += mantOdd;                     // ...and to even with this
+    o = uint16_t(f >> 13);
+  }
+  return o | uint16_t(sign >> 16);
+}
+
+uint32_t half_to_float_uint32_t_ref(uint16_t h)
+{
+  uint32_t sign = uint32_t(h & 0x8000) << 16, exp = (h >> 10) & 0x1f, mant = h & 0x3ff;
+  if (exp == 0x1f) // Inf/NaN
+    return sign | 0x7f800000u | (mant << 13);
+  if (exp == 0)
+  {
+    if (!mant)
+      return sign;
+    // denormal: normalize
+    exp = 127 - 15 + 1;
+    while (!(mant & 0x400))
+    {
+      mant <<= 1;
+      exp--;
+    }
+    return sign | (exp << 23) | ((mant & 0x3ff) << 13);
+  }
+  return sign | ((exp + 127 - 15) << 23) | (mant << 13);
+}
@@ -68,6 +68,33 @@ const char *BaseNameMap::getName(int i) const
 }
 
 
+size_t BaseNameMap::calcMemUsage(size_t *heap_bytes, int *heap_chunks) const
+{
+  size_t used = names.capacity() * sizeof(String);
+  size_t heap = 0;
+  int chunks = 0;
+  if (names.data())
+  {
+    heap += dag::get_allocator(names)->getSize((void *)names.data());
+    chunks++;
+  }
+  for (int i = 0; i < names.size(); ++i)
+  {
+    used += names[i].size();
+    if (names[i].data())
+    {
+      heap += dag::get_allocator(names[i])->getSize((void *)names[i].data());
+      chunks++;
+    }
+  }
+  if (heap_bytes)
+    *heap_bytes += heap;
+  if (heap_chunks)
+    *heap_chunks += chunks;
+  return used;
+}
+
+
 void BaseNameMap::copyFrom(const BaseNameMap &nm)
 {
   names = nm.names;
@@ -45,6 +45,10 @@ public:
   /// Load this name map.
   void load(FILE *);
 
+  /// Returns bytes used by names (including terminators) and name table capacity.
+  /// Allocator chunk sizes and number of allocations are added to @b heap_bytes / @b heap_chunks when specified.
+  size_t calcMemUsage(size_t *heap_bytes = NULL, int *heap_chunks = NULL) const;
+
 protected:
   Tab<String> names;
 
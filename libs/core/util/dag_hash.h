@@ -0,0 +1,123 @@
+//
+// Dagor Engine 6.5
+// Copyright (C) Gaijin Games KFT.  All rights reserved.
+//
+#pragma once
+
+#include <stdint.h>
+#include <string.h>
+#if defined(_MSC_VER) && defined(_M_X64)
+#include <intrin.h>
+#endif
+
+
+/// @file
+/// Fast non-cryptographic 64-bit hashing (wyhash-style), do not use it against malicious input.
+
+
+namespace dag_hash_internal
+{
+static constexpr uint64_t secret[4] = {0x2d358dccaa6c78a5ull, 0x8bb84b93962eacc9ull, 0x4b33a62ed433d4a3ull, 0x4d5a2da51de1aa47ull};
+
+// 64x64->128 multiplication, returns low and high halves in a and b
+inline void mum(uint64_t &a, uint64_t &b)
+{
+#if defined(__SIZEOF_INT128__)
+  __uint128_t r = (__uint128_t)a * b;
+  a = (uint64_t)r;
+  b = (uint64_t)(r >> 64);
+#elif defined(_MSC_VER) && defined(_M_X64)
+  a = _umul128(a, b, &b);
+#else
+  uint64_t ha = a >> 32, hb = b >> 32, la = (uint32_t)a, lb = (uint32_t)b;
+  uint64_t rh = ha * hb, rm0 = ha * lb, rm1 = hb * la, rl = la * lb, t = rl + (rm0 << 32), c = t < rl;
+  uint64_t lo = t + (rm1 << 32);
+  c += lo < t;
+  a = lo;
+  b = rh + (rm0 >> 32) + (rm1 >> 32) + c;
+#endif
+}
+
+inline uint64_t mix(uint64_t a, uint64_t b)
+{
+  mum(a, b);
+  return a ^ b;
+}
+
+inline uint64_t r8(const uint8_t *p)
+{
+  uint64_t v;
+  memcpy(&v, p, 8);
+  return v;
+}
+inline uint64_t r4(const uint8_t *p)
+{
+  uint32_t v;
+  memcpy(&v, p, 4);
+  return v;
+}
+inline uint64_t r3(const uint8_t *p, size_t k) { return (uint64_t(p[0]) << 16) | (uint64_t(p[k >> 1]) << 8) | p[k - 1]; }
+} // namespace dag_hash_internal
+
+
+/// Hashes @b len bytes at @b data.
+inline uint64_t mem_hash64(const void *data, size_t len, uint64_t seed = 0)
+{
+  using namespace dag_hash_internal;
+  const uint8_t *p = (const uint8_t *)data;
+  seed ^= mix(seed ^ secret[0], secret[1]);
+  uint64_t a, b;
+  if (len <= 16)
+  {
+    if (len >= 4)
+    {
+      a = (r4(p) << 32) | r4(p + ((len >> 3) << 2));
+      b = (r4(p + len - 4) << 32) | r4(p + len - 4 - ((len >> 3) << 2));
+    }
+    else if (len > 0)
+    {
+      a = r3(p, len);
+      b = 0;
+    }
+    else
+      a = b = 0;
+  }
+  else
+  {
+    size_t i = len;
+    if (i > 48)
+    {
+      uint64_t see1 = seed, see2 = seed;
+      do
+      {
+        seed = mix(r8(p) ^ secret[1], r8(p + 8) ^ seed);
+        see1 = mix(r8(p + 16) ^ secret[2], r8(p + 24) ^ see1);
+        see2 = mix(r8(p + 32) ^ secret[3], r8(p + 40) ^ see2);
+        p += 48;
+        i -= 48;
+      } while (i > 48);
+      seed ^= see1 ^ see2;
+    }
+    while (i > 16)
+    {
+      seed = mix(r8(p) ^ secret[1], r8(p + 8) ^ seed);
+      i -= 16;
+      p += 16;
+    }
+    a = r8(p + i - 16);
+    b = r8(p + i - 8);
+  }
+  a ^= secret[1];
+  b ^= seed;
+  mum(a, b);
+  return mix(a ^ secret[0] ^ len, b ^ secret[1]);
+}
+
+/// Hashes zero-terminated string (without terminator), NULL is hashed as empty string.
+inline uint64_t str_hash64(const char *s, uint64_t seed = 0) { return mem_hash64(s, s ? strlen(s) : 0, seed); }
+
+/// Order-dependent combination of hash @b h with value @b v.
+inline uint64_t hash64_combine(uint64_t h, uint64_t v)
+{
+  return dag_hash_internal::mix(h ^ dag_hash_internal::secret[0], v ^ dag_hash_internal::secret[1]);
+}
@@ -3,9 +3,12 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <charconv>
 
 #include <math/namemap.h>
 #include <memory/dag_mem.h>
+#include <ioSys/dag_genIo.h>
+#include <util/dag_hash.h>
 #include "datablock.h"
 
 TMatrix TMatrix::IDENT(1), TMatrix::ZERO(0);
@@ -271,8 +274,7 @@ void DataBlockParser::getValue(String &value)
     if (i < value.size())
       value.resize(i);
   }
-  value.push_back('\0');
-  value.pop_back(); // Keep buffer as c-string for caller but length correct
+  value.push_back('\0'); // String keeps terminator as last element
 }
 
 
@@ -466,11 +468,23 @@ char *create_buffer_str(const char *s)
 DataBlock *DataBlock::emptyBlock = NULL;
 // static const int currentVersion = _MAKE4C('1.1');//_MAKE4C('1.0');
 
-DataBlock::DataBlock(const DataBlock *blk) : nameId(-1), nameMap(blk->nameMap), valid(blk->valid), dataSrc(blk->dataSrc) {}
+DataBlock::DataBlock(DataBlock *parent_blk) :
+  nameId(-1),
+  nameMap(parent_blk->nameMap),
+  valid(parent_blk->valid),
+  dataSrc(parent_blk->dataSrc),
+  parent(parent_blk),
+  contentHashValid(false),
+  inArena(false),
+  arenaData(false),
+  contentHash(0),
+  arena(NULL)
+{}
 
 
 void DataBlock::setBlockName(const char *name)
 {
+  invalidateHash();
   // G_ASSERT(nameMap);
   nameId = nameMap->addNameId(name);
 }
@@ -479,12 +493,15 @@ int DataBlock::addBlock(DataBlock *blk)
 {
   if (!blk)
     return -1;
+  invalidateHash();
+  blk->parent = this;
   blocks.push_back(blk);
   return blocks.size() - 1;
 }
 
 int DataBlock::addParam(const char *name, int type, const char *value, int line, const char *filename)
 {
+  invalidateHash();
   params.emplace_back();
   Param &p = params.back();
 
@@ -499,7 +516,7 @@ int DataBlock::addParam(const char *name, int type, const char *value, int line,
     }
     break;
     case TYPE_INT: p.value.i = strtol(value, NULL, 0); break;
-    case TYPE_REAL: p.value.r = strtod(value, NULL); break;
+    case TYPE_REAL: p.value.r = strtof(value, NULL); break;
     case TYPE_POINT2:
     {
       p.value.p2 = Point2(0.f, 0.f);
@@ -592,8 +609,20 @@ int DataBlock::addParam(const char *name, int type, const char *value, int line,
 
 
 /*DLLEXPORT*/ DataBlock::DataBlock(const DataBlock &from) :
-  nameMap(from.nameMap), nameId(from.nameId), valid(from.valid), dataSrc(from.dataSrc)
-{
+  nameMap(new NameMap),
+  nameId(-1),
+  valid(from.valid),
+  dataSrc(from.dataSrc),
+  parent(NULL),
+  contentHashValid(false),
+  inArena(false),
+  arenaData(false),
+  contentHash(0),
+  arena(NULL)
+{
+  // copy is a root of new tree and owns its NameMap, so names are added by string
+  if (from.nameId >= 0)
+    setBlockName(from.getBlockName());
   setParamsFrom(&from);
 
   int num = from.blockCount();
@@ -623,40 +652,15 @@ int DataBlock::addParam(const char *name, int type, const char *value, int line,
 
 /*DLLEXPORT*/ bool DataBlock::removeBlock(const char *name)
 {
-  int nameId = getNameId(name);
-  if (nameId < 0)
-    return false;
-
-  bool removed = false;
-
-  for (int i = blocks.size() - 1; i >= 0; --i)
-    if (blocks[i] && blocks[i]->getBlockNameId() == nameId)
-    {
-      delete (blocks[i]);
-      blocks.erase(blocks.begin() + i);
-      removed = true;
-    }
-
-  return removed;
+  // single pass compaction, see removeBlocksIf()
+  return removeBlocksByNameId(getNameId(name)) > 0;
 }
 
 
 /*DLLEXPORT*/ bool DataBlock::removeParam(const char *name)
 {
-  int nameId = getNameId(name);
-  if (nameId < 0)
-    return false;
-
-  bool removed = false;
-
-  for (int i = params.size() - 1; i >= 0; --i)
-    if (params[i].nameId == nameId)
-    {
-      params.erase(params.begin() + i);
-      removed = true;
-    }
-
-  return removed;
+  // single pass compaction, see removeParamsIf()
+  return removeParamsByNameId(getNameId(name)) > 0;
 }
 
 
@@ -665,6 +669,7 @@ int DataBlock::addParam(const char *name, int type, const char *value, int line,
   if (!blk)
     return;
 
+  invalidateHash();
   params.clear();
 
   int num = blk->paramCount();
@@ -732,6 +737,7 @@ void DataBlock::setFrom(const DataBlock *from)
   if (id < 0 || params[id].type != TYPE_STRING)
     return addStr(name, value);
 
+  invalidateHash();
   memfree(params[id].value.s, strmem);
   params[id].value.s = create_buffer_str(value);
   return id;
@@ -743,6 +749,7 @@ void DataBlock::setFrom(const DataBlock *from)
   if (id < 0 || params[id].type != TYPE_BOOL)
     return addBool(name, value);
 
+  invalidateHash();
   params[id].value.b = value;
 
   return id;
@@ -754,6 +761,7 @@ void DataBlock::setFrom(const DataBlock *from)
   if (id < 0 || params[id].type != TYPE_INT)
     return addInt(name, value);
 
+  invalidateHash();
   params[id].value.i = value;
 
   return id;
@@ -765,6 +773,7 @@ void DataBlock::setFrom(const DataBlock *from)
   if (id < 0 || params[id].type != TYPE_REAL)
     return addReal(name, value);
 
+  invalidateHash();
   params[id].value.r = value;
 
   return id;
@@ -776,6 +785,7 @@ int DataBlock::setPoint2(const char *name, const Point2 &value)
   if (id < 0 || params[id].type != TYPE_POINT2)
     return addPoint2(name, value);
 
+  invalidateHash();
   params[id].value.p2 = value;
 
   return id;
@@ -787,6 +797,7 @@ int DataBlock::setPoint3(const char *name, const Point3 &value)
   if (id < 0 || params[id].type != TYPE_POINT3)
     return addPoint3(name, value);
 
+  invalidateHash();
   params[id].value.p3 = value;
 
   return id;
@@ -798,6 +809,7 @@ int DataBlock::setPoint4(const char *name, const Point4 &value)
   if (id < 0 || params[id].type != TYPE_POINT4)
     return addPoint4(name, value);
 
+  invalidateHash();
   params[id].value.p4 = value;
 
   return id;
@@ -809,6 +821,7 @@ int DataBlock::setIPoint2(const char *name, const IPoint2 &value)
   if (id < 0 || params[id].type != TYPE_IPOINT2)
     return addIPoint2(name, value);
 
+  invalidateHash();
   params[id].value.ip2 = value;
 
   return id;
@@ -820,6 +833,7 @@ int DataBlock::setIPoint3(const char *name, const IPoint3 &value)
   if (id < 0 || params[id].type != TYPE_IPOINT3)
     return addIPoint3(name, value);
 
+  invalidateHash();
   params[id].value.ip3 = value;
 
   return id;
@@ -831,6 +845,7 @@ int DataBlock::setIPoint3(const char *name, const IPoint3 &value)
   if (id < 0 || params[id].type != TYPE_E3DCOLOR)
     return addE3dcolor(name, value);
 
+  invalidateHash();
   params[id].value.c = value;
 
   return id;
@@ -843,6 +858,7 @@ int DataBlock::setTm(const char *name, const TMatrix &value)
   if (id < 0 || params[id].type != TYPE_MATRIX)
     return addTm(name, value);
 
+  invalidateHash();
   params[id].value.tm = value;
   return id;
 }
@@ -850,6 +866,7 @@ int DataBlock::setTm(const char *name, const TMatrix &value)
 
 /*DLLEXPORT*/ int DataBlock::addStr(const char *name, const char *value)
 {
+  invalidateHash();
   params.emplace_back();
   Param &p = params.back();
   p.nameId = nameMap->addNameId(name);
@@ -860,6 +877,7 @@ int DataBlock::setTm(const char *name, const TMatrix &value)
 
 /*DLLEXPORT*/ int DataBlock::addBool(const char *name, bool value)
 {
+  invalidateHash();
   params.emplace_back();
   Param &p = params.back();
   p.nameId = nameMap->addNameId(name);
@@ -870,6 +888,7 @@ int DataBlock::setTm(const char *name, const TMatrix &value)
 
 /*DLLEXPORT*/ int DataBlock::addInt(const char *name, int value)
 {
+  invalidateHash();
   params.emplace_back();
   Param &p = params.back();
   p.nameId = nameMap->addNameId(name);
@@ -880,6 +899,7 @@ int DataBlock::setTm(const char *name, const TMatrix &value)
 
 /*DLLEXPORT*/ int DataBlock::addReal(const char *name, real value)
 {
+  invalidateHash();
   params.emplace_back();
   Param &p = params.back();
   p.nameId = nameMap->addNameId(name);
@@ -890,6 +910,7 @@ int DataBlock::setTm(const char *name, const TMatrix &value)
 
 int DataBlock::addPoint2(const char *name, const Point2 &value)
 {
+  invalidateHash();
   params.emplace_back();
   Param &p = params.back();
   p.nameId = nameMap->addNameId(name);
@@ -900,6 +921,7 @@ int DataBlock::addPoint2(const char *name, const Point2 &value)
 
 int DataBlock::addPoint3(const char *name, const Point3 &value)
 {
+  invalidateHash();
   params.emplace_back();
   Param &p = params.back();
   p.nameId = nameMap->addNameId(name);
@@ -910,6 +932,7 @@ int DataBlock::addPoint3(const char *name, const Point3 &value)
 
 int DataBlock::addPoint4(const char *name, const Point4 &value)
 {
+  invalidateHash();
   params.emplace_back();
   Param &p = params.back();
   p.nameId = nameMap->addNameId(name);
@@ -920,6 +943,7 @@ int DataBlock::addPoint4(const char *name, const Point4 &value)
 
 int DataBlock::addIPoint2(const char *name, const IPoint2 &value)
 {
+  invalidateHash();
   params.emplace_back();
   Param &p = params.back();
   p.nameId = nameMap->addNameId(name);
@@ -930,6 +954,7 @@ int DataBlock::addIPoint2(const char *name, const IPoint2 &value)
 
 int DataBlock::addIPoint3(const char *name, const IPoint3 &value)
 {
+  invalidateHash();
   params.emplace_back();
   Param &p = params.back();
   p.nameId = nameMap->addNameId(name);
@@ -940,6 +965,7 @@ int DataBlock::addIPoint3(const char *name, const IPoint3 &value)
 
 /*DLLEXPORT*/ int DataBlock::addE3dcolor(const char *name, const E3DCOLOR value)
 {
+  invalidateHash();
   params.emplace_back();
   Param &p = params.back();
   p.nameId = nameMap->addNameId(name);
@@ -950,6 +976,7 @@ int DataBlock::addIPoint3(const char *name, const IPoint3 &value)
 
 /*DLLEXPORT*/ int DataBlock::addTm(const char *name, const TMatrix &value)
 {
+  invalidateHash();
   params.emplace_back();
   Param &p = params.back();
   p.nameId = nameMap->addNameId(name);
@@ -959,7 +986,12 @@ int DataBlock::addIPoint3(const char *name, const IPoint3 &value)
 }
 
 
-/*DLLEXPORT*/ DataBlock::DataBlock() : nameId(-1), nameMap(NULL), valid(true), dataSrc(SRC_UNKNOWN) { nameMap = new NameMap; }
+/*DLLEXPORT*/ DataBlock::DataBlock() :
+  nameId(-1), nameMap(NULL), valid(true), dataSrc(SRC_UNKNOWN), parent(NULL), contentHashValid(false), inArena(false),
+  arenaData(false), contentHash(0), arena(NULL)
+{
+  nameMap = new NameMap;
+}
 
 /*DLLEXPORT*/ DataBlock::~DataBlock()
 {
@@ -969,7 +1001,9 @@ int DataBlock::addIPoint3(const char *name, const IPoint3 &value)
   nameMap = NULL;
 }
 
-/*DLLEXPORT*/ DataBlock::DataBlock(const char *filename) : nameId(-1), nameMap(NULL), valid(true), dataSrc(SRC_UNKNOWN)
+/*DLLEXPORT*/ DataBlock::DataBlock(const char *filename) :
+  nameId(-1), nameMap(NULL), valid(true), dataSrc(SRC_UNKNOWN), parent(NULL), contentHashValid(false), inArena(false),
+  arenaData(false), contentHash(0), arena(NULL)
 {
   nameMap = new NameMap;
   load(filename);
@@ -988,14 +1022,49 @@ int DataBlock::addIPoint3(const char *name, const IPoint3 &value)
 // delete all children
 /*DLLEXPORT*/ void DataBlock::clearData()
 {
-  params.clear();
+  // relocated data is dropped in place instead of being copied out of arena first
+  bool inArenaData = arenaData;
+  arenaData = false;
+  invalidateHash();
   for (int i = 0; i < blocks.size(); ++i)
-    delete blocks[i];
-  blocks.clear();
+    deleteSubBlock(blocks[i]);
+  if (inArenaData)
+    releaseArenaTabs();
+  else
+  {
+    params.clear();
+    blocks.clear();
+  }
+  if (arena)
+  {
+    memfree(arena, midmem);
+    arena = NULL;
+  }
 }
 
 
-/*DLLEXPORT*/ bool DataBlock::loadText(Tab<char> &text, const char *filename)
+void DataBlock::deleteSubBlock(DataBlock *blk)
+{
+  if (!blk)
+    return;
+  blk->nameMap = NULL;
+  if (blk->inArena)
+    blk->~DataBlock();
+  else
+    delete blk;
+}
+
+
+void DataBlock::applyShrinkMode(ShrinkMode shrink_mode)
+{
+  if (shrink_mode == SHRINK_TABS)
+    shrink();
+  else if (shrink_mode == SHRINK_RELOCATE)
+    relocate();
+}
+
+
+/*DLLEXPORT*/ bool DataBlock::loadText(Tab<char> &text, const char *filename, ShrinkMode shrink_mode)
 {
   reset();
 
@@ -1019,6 +1088,7 @@ int DataBlock::addIPoint3(const char *name, const IPoint3 &value)
   }
 
   valid = true;
+  applyShrinkMode(shrink_mode);
   return true;
 }
 
@@ -1026,17 +1096,17 @@ void DataBlock::load(FILE *cb, class NameMap &stringMap)
 {
 }
 
-/*DLLEXPORT*/ bool DataBlock::loadText(char *text, int len, const char *filename)
+/*DLLEXPORT*/ bool DataBlock::loadText(char *text, int len, const char *filename, ShrinkMode shrink_mode)
 {
   Tab<char> buf;
   buf.insert(buf.end(), text, text + len);
   buf.push_back('\0');
 
-  return loadText(buf, filename);
+  return loadText(buf, filename, shrink_mode);
 }
 
 
-bool DataBlock::load(const char *fname)
+bool DataBlock::load(const char *fname, ShrinkMode shrink_mode)
 {
   reset();
   if (!fname || !*fname)
@@ -1063,11 +1133,11 @@ bool DataBlock::load(const char *fname)
     valid = false;
     return false;
   }
-  return loadFromStream(h, fileName);
+  return loadFromStream(h, fileName, shrink_mode);
 }
 
 
-bool DataBlock::loadFromStream(FILE *f, const char *fname)
+bool DataBlock::loadFromStream(FILE *f, const char *fname, ShrinkMode shrink_mode)
 {
   reset();
   fseek(f, 0, SEEK_END);
@@ -1091,7 +1161,7 @@ bool DataBlock::loadFromStream(FILE *f, const char *fname)
     return false;
   }
 
-  bool res = loadText(text, fname);
+  bool res = loadText(text, fname, shrink_mode);
   fclose(f);
   return res;
 }
@@ -1104,51 +1174,71 @@ void DataBlock::doLoadFromStream(FILE *crd)
 
 // Saving
 
-static void writeIndent(FILE *cb, int n)
+static void writeIndent(GeneralSaveCB &cb, int n)
 {
-  if (n <= 0)
-    return;
-  for (; n >= 8; n -= 8)
-    fwrite("        ", 8, 1, cb);
-  for (; n >= 2; n -= 2)
-    fwrite("  ", 2, 1, cb);
-  for (; n >= 1; n--)
-    fwrite(" ", 1, 1, cb);
+  static const char spaces[] = "                                ";
+  for (; n >= 32; n -= 32)
+    cb.write(spaces, 32);
+  if (n > 0)
+    cb.write(spaces, n);
 }
 
-static void writeString(FILE *cb, const char *s)
-{
-  if (!s || !*s)
-    return;
-  int l = (int)strlen(s);
-  fwrite(s, l, 1, cb);
-}
+static void writeString(GeneralSaveCB &cb, const char *s) { cb.writeStr(s); }
 
-static void writeStringValue(FILE *cb, const char *s)
+static void writeStringValue(GeneralSaveCB &cb, const char *s)
 {
   if (!s)
     s = "";
 
-  fwrite("\"", 1, 1, cb);
+  cb.write("\"", 1);
 
+  // write unescaped runs in one go
+  const char *run = s;
   for (; *s; ++s)
   {
-    char c = *s;
-    if (c == '~')
-      fwrite("~~", 2, 1, cb);
-    else if (c == '"')
-      fwrite("~\"", 2, 1, cb);
-    else if (c == '\r')
-      fwrite("~r", 2, 1, cb);
-    else if (c == '\n')
-      fwrite("~n", 2, 1, cb);
-    else if (c == '\t')
-      fwrite("~t", 2, 1, cb);
-    else
-      fwrite(&c, 1, 1, cb);
+    const char *esc;
+    switch (*s)
+    {
+      case '~': esc = "~~"; break;
+      case '"': esc = "~\""; break;
+      case '\r': esc = "~r"; break;
+      case '\n': esc = "~n"; break;
+      case '\t': esc = "~t"; break;
+      default: continue;
+    }
+    if (s > run)
+      cb.write(run, int(s - run));
+    cb.write(esc, 2);
+    run = s + 1;
   }
+  if (s > run)
+    cb.write(run, int(s - run));
 
-  fwrite("\"", 1, 1, cb);
+  cb.write("\"", 1);
+}
+
+// writes comma separated reals; exact mode uses shortest text that reads back to the same float
+static void writeReals(GeneralSaveCB &cb, const real *v, int n, bool exact, const char *sep, int sep_len)
+{
+  char buf[64];
+  for (int i = 0; i < n; ++i)
+  {
+    if (i)
+      cb.write(sep, sep_len);
+    int len = exact ? int(std::to_chars(buf, buf + sizeof(buf), v[i]).ptr - buf) : snprintf(buf, sizeof(buf), "%g", v[i]);
+    cb.write(buf, len);
+  }
+}
+
+static void writeInts(GeneralSaveCB &cb, const int *v, int n, const char *sep, int sep_len)
+{
+  char buf[16];
+  for (int i = 0; i < n; ++i)
+  {
+    if (i)
+      cb.write(sep, sep_len);
+    cb.write(buf, int(std::to_chars(buf, buf + sizeof(buf), v[i]).ptr - buf));
+  }
 }
 
 /*DLLEXPORT*/ void DataBlock::save(FILE *cb, class NameMap &stringMap) const
@@ -1156,14 +1246,26 @@ static void writeStringValue(FILE *cb, const char *s)
 }
 
 
-/*DLLEXPORT*/ void DataBlock::saveText(FILE *cb, int level) const
+/*DLLEXPORT*/ void DataBlock::saveText(GeneralSaveCB &cb, int level, int flags) const
 {
+  const bool exactReals = (flags & SAVE_TEXT_EXACT_REALS) != 0;
+  const bool singleLine = (flags & SAVE_TEXT_SINGLE_LINE) != 0;
+  const bool compact = singleLine || (flags & SAVE_TEXT_COMPACT);
+
+  // every param must be terminated, since unquoted values are read up to ';' or EOL
+  const char *paramEnd = singleLine ? ";" : compact ? "\n" : "\r\n";
+  const char *lineEnd = singleLine ? "" : compact ? "\n" : "\r\n";
+  const int paramEndLen = (int)strlen(paramEnd), lineEndLen = (int)strlen(lineEnd);
+  const char *sep = compact ? "," : ", ";
+  const int sepLen = compact ? 1 : 2;
+  const int indent = compact ? 0 : level * 2;
+
   int i;
   for (i = 0; i < params.size(); ++i)
   {
     const Param &p = params[i];
 
-    writeIndent(cb, level * 2);
+    writeIndent(cb, indent);
     writeString(cb, getName(p.nameId));
     switch (p.type)
     {
@@ -1171,97 +1273,63 @@ static void writeStringValue(FILE *cb, const char *s)
         writeString(cb, ":t=");
         writeStringValue(cb, p.value.s);
         break;
-      case TYPE_BOOL:
-      {
-        writeString(cb, ":b=");
-        char buf[32];
-        sprintf(buf, "%s", p.value.b ? "yes" : "no");
-        writeString(cb, buf);
-      }
-      break;
+      case TYPE_BOOL: writeString(cb, p.value.b ? ":b=yes" : ":b=no"); break;
       case TYPE_INT:
-      {
         writeString(cb, ":i=");
-        char buf[32];
-        sprintf(buf, "%d", p.value.i);
-        writeString(cb, buf);
-      }
-      break;
+        writeInts(cb, &p.value.i, 1, sep, sepLen);
+        break;
       case TYPE_REAL:
-      {
         writeString(cb, ":r=");
-        char buf[64];
-        sprintf(buf, "%g", p.value.r);
-        writeString(cb, buf);
-      }
-      break;
+        writeReals(cb, &p.value.r, 1, exactReals, sep, sepLen);
+        break;
       case TYPE_POINT2:
-      {
         writeString(cb, ":p2=");
-        char buf[128];
-        sprintf(buf, "%g, %g", p.value.p2.x, p.value.p2.y);
-        writeString(cb, buf);
-      }
-      break;
+        writeReals(cb, &p.value.p2.x, 2, exactReals, sep, sepLen);
+        break;
       case TYPE_POINT3:
-      {
         writeString(cb, ":p3=");
-        char buf[128];
-        sprintf(buf, "%g, %g, %g", p.value.p3.x, p.value.p3.y, p.value.p3.z);
-        writeString(cb, buf);
-      }
-      break;
+        writeReals(cb, &p.value.p3.x, 3, exactReals, sep, sepLen);
+        break;
       case TYPE_POINT4:
-      {
         writeString(cb, ":p4=");
-        char buf[160];
-        sprintf(buf, "%g, %g, %g, %g", p.value.p4.x, p.value.p4.y, p.value.p4.z, p.value.p4.w);
-        writeString(cb, buf);
-      }
-      break;
+        writeReals(cb, &p.value.p4.x, 4, exactReals, sep, sepLen);
+        break;
       case TYPE_IPOINT2:
-      {
         writeString(cb, ":ip2=");
-        char buf[128];
-        sprintf(buf, "%d, %d", p.value.ip2.x, p.value.ip2.y);
-        writeString(cb, buf);
-      }
-      break;
+        writeInts(cb, &p.value.ip2.x, 2, sep, sepLen);
+        break;
       case TYPE_IPOINT3:
-      {
         writeString(cb, ":ip3=");
-        char buf[128];
-        sprintf(buf, "%d, %d, %d", p.value.ip3.x, p.value.ip3.y, p.value.ip3.z);
-        writeString(cb, buf);
-      }
-      break;
+        writeInts(cb, &p.value.ip3.x, 3, sep, sepLen);
+        break;
       case TYPE_E3DCOLOR:
       {
         writeString(cb, ":c=");
-        char buf[128];
-        sprintf(buf, "%d, %d, %d, %d", p.value.c.r, p.value.c.g, p.value.c.b, p.value.c.a);
-        writeString(cb, buf);
+        int c[4] = {p.value.c.r, p.value.c.g, p.value.c.b, p.value.c.a};
+        writeInts(cb, c, 4, sep, sepLen);
       }
       break;
       case TYPE_MATRIX:
-      {
-        writeString(cb, ":m=");
-        char buf[256];
-        sprintf(buf, "[[%g, %g, %g] [%g, %g, %g] [%g, %g, %g] [%g, %g, %g]]", p.value.tm.getcol(0).x, p.value.tm.getcol(0).y,
-          p.value.tm.getcol(0).z, p.value.tm.getcol(1).x, p.value.tm.getcol(1).y, p.value.tm.getcol(1).z, p.value.tm.getcol(2).x,
-          p.value.tm.getcol(2).y, p.value.tm.getcol(2).z, p.value.tm.getcol(3).x, p.value.tm.getcol(3).y, p.value.tm.getcol(3).z);
-        writeString(cb, buf);
+        writeString(cb, ":m=[");
+        for (int c = 0; c < 4; ++c)
+        {
+          if (c && !compact)
+            cb.write(" ", 1);
+          cb.write("[", 1);
+          writeReals(cb, &p.value.tm.m[c][0], 3, exactReals, sep, sepLen);
+          cb.write("]", 1);
+        }
+        cb.write("]", 1);
         break;
-      }
       default: debug("unknown type");
     }
-    fwrite("\r\n", 2, 1, cb);
+    cb.write(paramEnd, paramEndLen);
   }
 
-  if (!params.empty() && !blocks.empty())
+  if (!compact && !params.empty() && !blocks.empty())
   {
-    writeIndent(cb, level * 2);
-    fwrite("\r\n", 2, 1, cb);
+    writeIndent(cb, indent);
+    cb.write("\r\n", 2);
   }
   for (i = 0; i < blocks.size(); ++i)
   {
@@ -1269,21 +1337,23 @@ static void writeStringValue(FILE *cb, const char *s)
     if (!&b)
       continue;
 
-    writeIndent(cb, level * 2);
+    writeIndent(cb, indent);
     writeString(cb, getName(b.nameId));
-    fwrite("{\r\n", 3, 1, cb);
+    cb.write("{", 1);
+    cb.write(lineEnd, lineEndLen);
 
-    b.saveText(cb, level + 1);
+    b.saveText(cb, level + 1, flags);
 
-    writeIndent(cb, level * 2);
-    fwrite("}\r\n", 3, 1, cb);
+    writeIndent(cb, indent);
+    cb.write("}", 1);
+    cb.write(lineEnd, lineEndLen);
 
-    if (i != blocks.size() - 1)
-      fwrite("\r\n", 2, 1, cb);
+    if (!compact && i != blocks.size() - 1)
+      cb.write("\r\n", 2);
   }
 }
 
-/*DLLEXPORT*/ bool DataBlock::saveToTextFile(const char *filename) const
+/*DLLEXPORT*/ bool DataBlock::saveToTextFile(const char *filename, int flags) const
 {
   String fileName(filename);
   FILE *h = fopen(fileName, "w+b");
@@ -1294,12 +1364,16 @@ static void writeStringValue(FILE *cb, const char *s)
     return false;
   }
 
-  saveText(h);
+  FileGeneralSaveCB cwr(h);
+  saveText(cwr, 0, flags);
   fclose(h);
   return true;
 }
 
 
+/*DLLEXPORT*/ void DataBlock::saveToTextStream(GeneralSaveCB &cwr, int flags) const { saveText(cwr, 0, flags); }
+
+
 /*DLLEXPORT*/ void DataBlock::fillNameMap(NameMap *stringMap) const
 {
   if (!stringMap)
@@ -1346,6 +1420,44 @@ bool DataBlock::saveToBinaryFile(const char *filename) const
   return nameMap->getName(nid);
 }
 
+static void append_path(char *buf, int buf_size, int &len, const char *s, int n)
+{
+  if (len + 1 < buf_size)
+  {
+    int c = len + n < buf_size ? n : buf_size - 1 - len;
+    memcpy(buf + len, s, c);
+    buf[len + c] = '\0';
+  }
+  len += n;
+}
+
+/*DLLEXPORT*/ int DataBlock::getBlockPath(char *buf, int buf_size) const
+{
+  if (!parent)
+  {
+    if (buf_size > 0)
+      buf[0] = '\0';
+    return 0;
+  }
+  int len = parent->getBlockPath(buf, buf_size);
+  int ord = 0;
+  for (int i = 0; i < parent->blocks.size() && parent->blocks[i] != this; ++i)
+    if (parent->blocks[i]->nameId == nameId)
+      ord++;
+
+  const char *name = getBlockName();
+  if (len)
+    append_path(buf, buf_size, len, "/", 1);
+  if (name)
+    append_path(buf, buf_size, len, name, (int)strlen(name));
+  if (ord > 0)
+  {
+    char tmp[16];
+    append_path(buf, buf_size, len, tmp, snprintf(tmp, sizeof(tmp), "[%d]", ord));
+  }
+  return len;
+}
+
 // Sub-blocks
 
 /*DLLEXPORT*/ DataBlock *DataBlock::getBlock(int i) const
@@ -1601,6 +1713,66 @@ TMatrix DataBlock::getTm(const char *name, TMatrix &def) const
 }
 
 
+uint64_t DataBlock::getContentHash() const
+{
+  if (!contentHashValid)
+  {
+    contentHash = calcContentHash();
+    contentHashValid = true;
+  }
+  return contentHash;
+}
+
+uint64_t DataBlock::calcContentHash() const
+{
+  uint64_t h = hash64_combine(params.size(), blocks.size());
+  for (int i = 0; i < params.size(); ++i)
+  {
+    const Param &p = params[i];
+    h = hash64_combine(h, str_hash64(getName(p.nameId), p.type));
+    switch (p.type)
+    {
+      case TYPE_STRING: h = hash64_combine(h, str_hash64(p.value.s)); break;
+      case TYPE_INT: h = hash64_combine(h, (uint32_t)p.value.i); break;
+      case TYPE_BOOL: h = hash64_combine(h, p.value.b); break;
+      case TYPE_REAL: h = hash64_combine(h, mem_hash64(&p.value.r, sizeof(real))); break;
+      case TYPE_POINT2: h = hash64_combine(h, mem_hash64(&p.value.p2, sizeof(Point2))); break;
+      case TYPE_POINT3: h = hash64_combine(h, mem_hash64(&p.value.p3, sizeof(Point3))); break;
+      case TYPE_POINT4: h = hash64_combine(h, mem_hash64(&p.value.p4, sizeof(Point4))); break;
+      case TYPE_IPOINT2: h = hash64_combine(h, mem_hash64(&p.value.ip2, sizeof(IPoint2))); break;
+      case TYPE_IPOINT3: h = hash64_combine(h, mem_hash64(&p.value.ip3, sizeof(IPoint3))); break;
+      case TYPE_E3DCOLOR: h = hash64_combine(h, p.value.c.u); break;
+      case TYPE_MATRIX: h = hash64_combine(h, mem_hash64(&p.value.tm, sizeof(TMatrix))); break;
+    }
+  }
+  for (int i = 0; i < blocks.size(); ++i)
+    h = hash64_combine(hash64_combine(h, str_hash64(blocks[i]->getBlockName())), blocks[i]->getContentHash());
+  return h;
+}
+
+
+bool DataBlock::isParamValueEqual(const Param &a, const Param &b)
+{
+  if (a.type != b.type)
+    return false;
+  switch (a.type)
+  {
+    case TYPE_STRING: return strcmp(a.value.s, b.value.s) == 0;
+    case TYPE_INT: return a.value.i == b.value.i;
+    case TYPE_BOOL: return a.value.b == b.value.b;
+    case TYPE_REAL: return memcmp(&a.value.r, &b.value.r, sizeof(real)) == 0;
+    case TYPE_POINT2: return memcmp(&a.value.p2, &b.value.p2, sizeof(Point2)) == 0;
+    case TYPE_POINT3: return memcmp(&a.value.p3, &b.value.p3, sizeof(Point3)) == 0;
+    case TYPE_POINT4: return memcmp(&a.value.p4, &b.value.p4, sizeof(Point4)) == 0;
+    case TYPE_IPOINT2: return a.value.ip2 == b.value.ip2;
+    case TYPE_IPOINT3: return a.value.ip3 == b.value.ip3;
+    case TYPE_E3DCOLOR: return a.value.c == b.value.c;
+    case TYPE_MATRIX: return memcmp(&a.value.tm, &b.value.tm, sizeof(TMatrix)) == 0;
+  }
+  return true;
+}
+
+
 /*DLLEXPORT*/ DataBlock::Param::Param() : nameId(-1), type(TYPE_NONE) { memset(&value, 0, sizeof(value)); }
 
 /*DLLEXPORT*/ DataBlock::Param::~Param()
@@ -1608,3 +1780,35 @@ TMatrix DataBlock::getTm(const char *name, TMatrix &def) const
   if (type == TYPE_STRING)
     memfree(value.s, strmem);
 }
+
+DataBlock::Param::Param(Param &&p) : nameId(p.nameId), type(p.type)
+{
+  memcpy(&value, &p.value, sizeof(value));
+  p.type = TYPE_NONE; // string buffer is owned by this param now
+}
+
+void DataBlock::Param::setValueFrom(const Param &p)
+{
+  if (type == TYPE_STRING)
+    memfree(value.s, strmem);
+  type = p.type;
+  if (type == TYPE_STRING)
+    value.s = create_buffer_str(p.value.s);
+  else
+    memcpy(&value, &p.value, sizeof(value));
+}
+
+DataBlock::Param &DataBlock::Param::operator=(Param &&p)
+{
+  Value v;
+  memcpy(&v, &value, sizeof(v));
+  memcpy(&value, &p.value, sizeof(value));
+  memcpy(&p.value, &v, sizeof(v));
+  int t = nameId;
+  nameId = p.nameId;
+  p.nameId = t;
+  t = type;
+  type = p.type;
+  p.type = t;
+  return *this;
+}
@@ -24,6 +24,11 @@
 class GeneralLoadCB;
 class GeneralSaveCB;
 class NameMap;
+class DataBlockDiffCB;
+namespace danet
+{
+class BitStream;
+}
 
 /// @addtogroup utility_classes
 /// @{
@@ -87,6 +92,15 @@ public:
   };
 
 
+  /// Text saving flags, can be combined.
+  enum SaveTextFlags
+  {
+    SAVE_TEXT_EXACT_REALS = 0x1, ///< Write reals in shortest form that loads back bit-exact (instead of %g).
+    SAVE_TEXT_COMPACT = 0x2,     ///< No indentation and blank lines, single LF line ends.
+    SAVE_TEXT_SINGLE_LINE = 0x4, ///< Like SAVE_TEXT_COMPACT, but params end with ';' and no line ends are written.
+  };
+
+
   /// Default constructor, constructs empty block.
   DataBlock();
 
@@ -107,27 +121,36 @@ public:
   void reset();
 
   /// @name Loading
+  /// All loading methods accept optional @b shrink_mode (see ShrinkMode) applied to successfully loaded tree.
   /// @{
 
+  /// Post-load memory compaction modes.
+  enum ShrinkMode
+  {
+    SHRINK_NONE,     ///< Keep arrays with slack left by parser.
+    SHRINK_TABS,     ///< Trim param and sub-block arrays, see shrink().
+    SHRINK_RELOCATE, ///< Move whole tree into single allocation, see relocate().
+  };
+
   /// Load DataBlock tree from specified text.
   /// Filename is for error output only.
-  bool loadText(char *text, int text_length, const char *filename = NULL);
+  bool loadText(char *text, int text_length, const char *filename = NULL, ShrinkMode shrink_mode = SHRINK_NONE);
 
   /// Load DataBlock tree from specified text.
   /// Filename is for error output only.
   /// @note This method will modify @b text when including files.
-  bool loadText(Tab<char> &text, const char *filename = NULL);
+  bool loadText(Tab<char> &text, const char *filename = NULL, ShrinkMode shrink_mode = SHRINK_NONE);
 
   /// Load DataBlock tree from arbitrary stream
   /// Data may be presented like text, binary or stream data
   /// created by function beginTaggedBlock(_MAKE4C('blk'))
   /// fname uses if loading from text file to right parse include directives
-  bool loadFromStream(FILE *crd, const char *fname = NULL);
+  bool loadFromStream(FILE *crd, const char *fname = NULL, ShrinkMode shrink_mode = SHRINK_NONE);
 
   /// Load DataBlock tree from any type of file, binary or text
   /// First function try to load file as binary, in fail case it
   /// try to load file as text
-  bool load(const char *fname);
+  bool load(const char *fname, ShrinkMode shrink_mode = SHRINK_NONE);
 
   /// @}
 
@@ -136,7 +159,13 @@ public:
   /// @{
 
   /// Save this DataBlock (and its sub-tree) to the specified file (text form)
-  bool saveToTextFile(const char *filename) const;
+  /// @b flags is combination of SaveTextFlags.
+  bool saveToTextFile(const char *filename, int flags = 0) const;
+
+  /// Save this DataBlock (and its sub-tree) to arbitrary output stream (text form).
+  /// Text is written directly to the stream, e.g. DynamicMemGeneralSaveCB for memory buffer
+  /// or CallbackGeneralSaveCB for user-supplied sink.
+  void saveToTextStream(GeneralSaveCB &cwr, int flags = 0) const;
 
   /// Save this DataBlock (and its sub-tree) to arbitrary stream (binary form)
   void saveToStream(GeneralSaveCB &cwr) const;
@@ -171,6 +200,10 @@ public:
   /// Returns name of this DataBlock.
   INLINE const char *getBlockName() const { return getName(nameId); }
 
+  /// Writes '/'-separated chain of block names from tree root to this DataBlock into @b buf
+  /// (same format as DataBlockDiffCB paths), truncated to fit @b buf_size. Returns length of full path.
+  int getBlockPath(char *buf, int buf_size) const;
+
   /// @}
 
 
@@ -227,6 +260,35 @@ public:
   /// Returns false if no sub-blocks were removed.
   bool removeBlock(const char *name);
 
+  /// Remove all sub-blocks with specified name id.
+  /// Returns number of removed sub-blocks.
+  int removeBlocksByNameId(int name_id)
+  {
+    return name_id < 0 ? 0 : removeBlocksIf([&](int i) { return blocks[i]->nameId == name_id; });
+  }
+
+  /// Remove all sub-blocks for which @b pred(block_number) returns true, in single pass.
+  /// Predicate is called once per sub-block in order and may inspect only sub-block with given number.
+  /// Returns number of removed sub-blocks.
+  template <typename Pred>
+  int removeBlocksIf(Pred pred)
+  {
+    int w = 0, n = blocks.size();
+    for (int i = 0; i < n; ++i)
+      if (pred(i))
+      {
+        if (w == i) // first removed one, nothing is modified yet
+          invalidateHash();
+        deleteSubBlock(blocks[i]);
+      }
+      else
+        blocks[w++] = blocks[i];
+    if (w == n)
+      return 0;
+    blocks.erase(blocks.begin() + w, blocks.end());
+    return n - w;
+  }
+
   /// Similar to addNewBlock(const DataBlock *copy_from, const char *as_name),
   /// but removes existing sub-blocks with the same name first.
   DataBlock *setBlock(const DataBlock *blk, const char *as_name = NULL)
@@ -378,6 +440,162 @@ public:
   /// Returns false if no parameters were removed.
   bool removeParam(const char *name);
 
+  /// Remove all parameters with the specified name id.
+  /// Returns number of removed parameters.
+  int removeParamsByNameId(int name_id)
+  {
+    return name_id < 0 ? 0 : removeParamsIf([&](int i) { return params[i].nameId == name_id; });
+  }
+
+  /// Remove all parameters of the specified type (see ParamType).
+  /// Returns number of removed parameters.
+  int removeParamsByType(int type)
+  {
+    return removeParamsIf([&](int i) { return params[i].type == type; });
+  }
+
+  /// Remove all parameters for which @b pred(param_number) returns true, in single pass
+  /// (kept parameters are moved once, removed ones are freed together at the end).
+  /// Predicate is called once per parameter in order and may inspect only parameter with given number.
+  /// Returns number of removed parameters.
+  template <typename Pred>
+  int removeParamsIf(Pred pred)
+  {
+    int w = 0, n = params.size();
+    for (int i = 0; i < n; ++i)
+      if (!pred(i))
+      {
+        if (w != i)
+          params[w] = eastl::move(params[i]);
+        ++w;
+      }
+      else if (w == i) // first removed one, nothing is modified yet
+        invalidateHash();
+    if (w == n)
+      return 0;
+    params.erase(params.begin() + w, params.end());
+    return n - w;
+  }
+
+  /// @}
+
+  /// @name Comparison
+  /// @{
+
+  /// Reports differences from this DataBlock tree to @b to tree via @b cb.
+  /// Params and sub-blocks are matched by name and occurrence order among same-named siblings.
+  /// Trees may use different NameMaps (names are remapped once), shared NameMap makes it cheaper.
+  void diff(const DataBlock &to, DataBlockDiffCB &cb) const;
+
+  /// Returns 64-bit hash of this DataBlock contents: params (names, types, values) and sub-blocks (names, contents),
+  /// own block name is not included. Names are hashed by string, so hashes of trees with different NameMaps match.
+  ///
+  /// Hash is computed lazily and cached per block; any modification invalidates cached hashes of the block
+  /// and all its parents, so repeated calls on unchanged (sub)trees are O(1).
+  /// Hash is not cryptographic: equal hashes mean equal contents only with very high probability.
+  ///
+  /// Computing hash writes cache, so it is not thread safe even on const tree. Call it on root before sharing tree
+  /// between threads: this computes hashes of all sub-blocks, and then calls on any block of unchanged tree only read.
+  uint64_t getContentHash() const;
+
+  /// @}
+
+  /// @name Patching
+  /// Binary delta between two versions of DataBlock tree, e.g. for sending config updates instead of whole BLK.
+  ///
+  /// Patch consists of names table and positional ops (set/insert/remove params, insert/remove sub-blocks,
+  /// enter sub-block), so it can be applied only to the tree with exactly the same contents it was made from.
+  /// @{
+
+  /// Appends patch that turns this DataBlock tree into @b to tree to @b patch stream.
+  /// Returns false if trees are equal (patch is still written and applying it does nothing).
+  bool makePatch(const DataBlock &to, danet::BitStream &patch) const;
+
+  /// Applies patch read from @b patch stream (from its current read offset) to this DataBlock tree in place.
+  /// Returns false on malformed or truncated patch; tree is left partially patched in this case.
+  bool applyPatch(const danet::BitStream &patch);
+
+  /// @}
+
+  /// @name Merging
+  /// @{
+
+  /// Merge flags, can be combined.
+  enum MergeFlags
+  {
+    MERGE_APPEND_PARAMS = 0x1,  ///< Append all params instead of replacing same-named ones.
+    MERGE_APPEND_BLOCKS = 0x2,  ///< Append all sub-blocks instead of merging into same-named ones.
+    MERGE_REPLACE_BLOCKS = 0x4, ///< Replace same-named sub-blocks as a whole instead of merging into them.
+    MERGE_IGNORE_MARKERS = 0x8, ///< Treat "__delete" and "__override" params as regular ones.
+  };
+
+  /// Overlays @b over tree onto this one in place (base/platform/user configs layering).
+  ///
+  /// By default params and sub-blocks are paired by name and occurrence order among same-named siblings:
+  /// i-th "x" param of @b over replaces value (and type) of i-th "x" param of this block, i-th "obj" sub-block
+  /// is merged recursively into i-th "obj" sub-block; unpaired items are appended. See MergeFlags for other modes.
+  ///
+  /// Markers in @b over blocks (not copied to result):
+  /// - "__delete:t=name" removes all params and sub-blocks named "name" before merging this block;
+  /// - "__override:b=yes" in sub-block makes it replace paired sub-block as a whole.
+  ///
+  /// Done in single traversal without intermediate copies, @b over may use different NameMap,
+  /// but must not be a part of this tree.
+  void mergeFrom(const DataBlock &over, int flags = 0);
+
+  /// @}
+
+  /// @name Memory Usage
+  /// @{
+
+  /// Memory footprint of DataBlock sub-tree, see calcMemUsage().
+  struct MemUsage
+  {
+    int blocks, params, strings;
+    size_t nodeBytes;                        ///< DataBlock objects.
+    size_t paramsUsed, paramsReserved;       ///< Param arrays, size() and capacity() in bytes.
+    size_t blockPtrsUsed, blockPtrsReserved; ///< Sub-block pointer arrays, size() and capacity() in bytes.
+    size_t stringBytes;                      ///< String param values, including terminators.
+    size_t nameMapBytes;                     ///< NameMap names and table (counted for tree root only).
+    /// Allocator chunk sizes and number of allocations of all above (except root DataBlock object itself),
+    /// comparable with dagor_memory_stat::get_memory_allocated() and get_memchunk_count().
+    size_t heapBytes;
+    int heapChunks;
+
+    size_t usedBytes() const { return nodeBytes + paramsUsed + blockPtrsUsed + stringBytes + nameMapBytes; }
+    /// Reserved but unused capacity of param and sub-block arrays.
+    size_t wastedBytes() const { return paramsReserved - paramsUsed + blockPtrsReserved - blockPtrsUsed; }
+  };
+
+  /// Block entry of calcMemUsage() heaviest blocks list.
+  struct MemUsageTop
+  {
+    const DataBlock *blk;
+    size_t ownBytes;     ///< Heap bytes owned by block itself: object, param and sub-block arrays, string values.
+    size_t subtreeBytes; ///< ownBytes of block and all its sub-blocks.
+  };
+
+  /// Calculates memory used by this DataBlock and its sub-tree into @b usage, nothing is allocated.
+  /// If @b top is not NULL, it receives up to @b top_count blocks with largest ownBytes, heaviest first;
+  /// returns number of filled entries (use getBlockPath() to name them).
+  int calcMemUsage(MemUsage &usage, MemUsageTop *top = NULL, int top_count = 0) const;
+
+  /// Prints calcMemUsage() results with @b top_count heaviest blocks to debug output,
+  /// together with share of total allocated memory reported by dagor_memory_stat.
+  void dumpMemUsage(int top_count = 10) const;
+
+  /// Trims capacity of param and sub-block arrays of this block and its sub-tree down to their sizes
+  /// (parser and add*() methods grow them geometrically).
+  void shrink();
+
+  /// Moves sub-blocks, param and sub-block arrays and string values of whole tree into single exactly sized
+  /// allocation, in depth-first order, for locality and zero allocator overhead. NameMap is not moved.
+  /// Can be called for tree root only, returns false otherwise.
+  ///
+  /// Relocated tree is copy-on-write: first modification of a block moves its params and sub-block list
+  /// back to regular heap allocations (sub-block objects stay in place), memory is released with root contents.
+  bool relocate();
+
   /// @}
 
   /// @name Other methods
@@ -395,19 +613,54 @@ protected:
   /// @cond
   friend class DataBlockParser;
 
-  DataBlock(const DataBlock *);
+  /// Constructs sub-block of @b parent_blk tree (shares its NameMap).
+  DataBlock(DataBlock *parent_blk);
 
   void setBlockName(const char *name);
 
+  /// Marks cached content hash of this block and its parents as outdated, must be called on any modification
+  /// (before it, as relocated block data is made writable here).
+  /// Stops at first already invalid block: valid hash of a block implies valid hashes of all its sub-blocks.
+  INLINE void invalidateHash()
+  {
+    if (arenaData)
+      detachArenaData();
+    for (DataBlock *b = this; b && b->contentHashValid; b = b->parent)
+      b->contentHashValid = false;
+  }
+  uint64_t calcContentHash() const;
+
   int addBlock(DataBlock *);
 
   int addParam(const char *name, int type, const char *value, int line, const char *filename);
 
-  void shrink();
+  struct Param;
+  static bool isParamValueEqual(const Param &a, const Param &b);
+
+  struct NameMatcher;
+  struct DiffContext;
+  void doDiff(const DataBlock &b, DiffContext &ctx) const;
+
+  struct PatchWriter;
+  struct PatchReader;
+
+  struct MergeContext;
+
+  struct MemUsageContext;
+
+  /// Deletes sub-block of this tree (sub-blocks share NameMap with root, so it is not deleted).
+  static void deleteSubBlock(DataBlock *blk);
+
+  struct ArenaBuilder;
+  /// Copies params and sub-block list of relocated block to regular heap allocations.
+  void detachArenaData();
+  /// Forgets params and sub-block list placed in arena, without freeing them.
+  void releaseArenaTabs();
+  void applyShrinkMode(ShrinkMode shrink_mode);
 
   /// Save this DataBlock (and its sub-tree) in the text form.
-  /// @b level is used for text indentation.
-  void saveText(FILE *cb, int level = 0) const;
+  /// @b level is used for text indentation, @b flags is combination of SaveTextFlags.
+  void saveText(GeneralSaveCB &cb, int level = 0, int flags = 0) const;
   /// helper routine to save data tree
   void save(FILE *cb, NameMap &stringMap) const;
   /// helper routine to load data tree
@@ -463,6 +716,13 @@ protected:
 
     Param();
     ~Param();
+    Param(Param &&p);
+    Param &operator=(Param &&p);
+    Param(const Param &) = delete;
+    Param &operator=(const Param &) = delete;
+
+    /// Copies type and value (string is duplicated), name id is kept.
+    void setValueFrom(const Param &p);
   };
 
   int nameId;
@@ -471,6 +731,13 @@ protected:
 
   bool valid;
   DataSrc dataSrc;
+
+  DataBlock *parent;
+  mutable bool contentHashValid;
+  bool inArena;   // block object is placed in arena of tree root (see relocate()), it is not deleted separately
+  bool arenaData; // params, sub-block list and string values are in arena
+  mutable uint64_t contentHash;
+  void *arena; // single allocation owned by tree root
   /// @endcond
 
 private:
@@ -485,6 +752,29 @@ private:
   //   bool loadBinaryFile(const char *filename, bool& can_process_file);
 };
 
+
+
+/// Callback interface for DataBlock::diff().
+/// @b path is '/'-separated chain of block names ending with param or block name;
+/// for repeated names occurrence index is appended as "name[N]" (when N > 0).
+class DataBlockDiffCB
+{
+public:
+  enum Kind
+  {
+    ADDED,   ///< Present only in 'to' tree.
+    REMOVED, ///< Present only in 'from' tree.
+    CHANGED, ///< Param present in both trees, but type or value differs.
+  };
+
+  /// Param difference; @b from / @b to are blocks holding the param (NULL on the side where it is absent)
+  /// and @b from_idx / @b to_idx are param indices in them (-1 when absent).
+  virtual void onParam(Kind kind, const char *path, const DataBlock *from, int from_idx, const DataBlock *to, int to_idx) = 0;
+
+  /// Sub-block is ADDED or REMOVED as a whole (its contents are not reported separately).
+  virtual void onBlock(Kind kind, const char *path, const DataBlock *from, const DataBlock *to) = 0;
+};
+
 #undef INLINE
 
 // #include "undef_.h"
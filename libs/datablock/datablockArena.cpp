@@ -0,0 +1,190 @@
+// Copyright (C) Gaijin Games KFT.  All rights reserved.
+
+#include <string.h>
+
+#include <memory/dag_mem.h>
+#include "datablock.h"
+
+
+// Lays out relocated tree in single allocation: block object, its params, sub-block list and strings,
+// then the same for sub-blocks, depth-first. Same walk is done twice: without memory to measure, then to build.
+// Tabs get their storage by reserve() with this object set as allocator, so they need no special support.
+struct DataBlock::ArenaBuilder : public IMemAlloc
+{
+  static constexpr size_t ALIGN = alignof(Param) > alignof(DataBlock) ? alignof(Param) : alignof(DataBlock);
+
+  char *base = NULL;
+  size_t pos = 0;
+
+  void *take(size_t sz, size_t align)
+  {
+    pos = (pos + align - 1) & ~(align - 1);
+    void *p = base ? base + pos : NULL;
+    pos += sz;
+    return p;
+  }
+
+  // same size as dag::Vector requests from allocator for reserve(n)
+  template <typename T>
+  static size_t tabBytes(int n)
+  {
+    if (!n)
+      return 0;
+    size_t minCount = 16 / sizeof(T);
+    return (size_t(n) > minCount ? size_t(n) : minCount) * sizeof(T);
+  }
+
+  template <typename T>
+  void makeTab(Tab<T> &t, int n)
+  {
+    if (!n)
+      return;
+    dag::set_allocator(t, this);
+    t.reserve(n);
+    dag::set_allocator(t, midmem);
+  }
+
+  void measure(const DataBlock &src);
+  void copyItems(const DataBlock &src, Tab<Param> &params, Tab<DataBlock *> &blocks, DataBlock *owner);
+
+  // IMemAlloc: only plain alloc() is used by Tab::reserve()
+  void destroy() override {}
+  bool isEmpty() override { return false; }
+  size_t getSize(void *) override { return 0; }
+  void *alloc(size_t sz) override { return take(sz, ALIGN); }
+  void *tryAlloc(size_t sz) override { return take(sz, ALIGN); }
+  void *allocAligned(size_t sz, size_t alignment) override { return take(sz, alignment > ALIGN ? alignment : ALIGN); }
+  bool resizeInplace(void *, size_t) override { return false; }
+  void *realloc(void *, size_t) override { return NULL; }
+  void free(void *) override {}
+  void freeAligned(void *) override {}
+};
+
+
+void DataBlock::ArenaBuilder::measure(const DataBlock &src)
+{
+  take(tabBytes<Param>(src.params.size()), ALIGN);
+  for (int i = 0; i < src.params.size(); ++i)
+    if (src.params[i].type == TYPE_STRING)
+      take(strlen(src.params[i].value.s) + 1, 1);
+  take(tabBytes<DataBlock *>(src.blocks.size()), ALIGN);
+  for (int i = 0; i < src.blocks.size(); ++i)
+    take(sizeof(DataBlock), ALIGN);
+  for (int i = 0; i < src.blocks.size(); ++i)
+    measure(*src.blocks[i]);
+}
+
+void DataBlock::ArenaBuilder::copyItems(const DataBlock &src, Tab<Param> &params, Tab<DataBlock *> &blocks, DataBlock *owner)
+{
+  makeTab(params, src.params.size());
+  for (int i = 0; i < src.params.size(); ++i)
+  {
+    const Param &sp = src.params[i];
+    params.emplace_back();
+    Param &p = params.back();
+    p.nameId = sp.nameId;
+    p.type = sp.type;
+    memcpy(&p.value, &sp.value, sizeof(p.value));
+    if (sp.type == TYPE_STRING)
+    {
+      size_t len = strlen(sp.value.s) + 1;
+      p.value.s = (char *)take(len, 1);
+      memcpy(p.value.s, sp.value.s, len);
+    }
+  }
+
+  makeTab(blocks, src.blocks.size());
+  for (int i = 0; i < src.blocks.size(); ++i)
+  {
+    const DataBlock &sb = *src.blocks[i];
+    DataBlock *b = new (take(sizeof(DataBlock), ALIGN)) DataBlock(owner);
+    b->nameId = sb.nameId;
+    b->valid = sb.valid;
+    b->dataSrc = sb.dataSrc;
+    b->contentHashValid = sb.contentHashValid;
+    b->contentHash = sb.contentHash;
+    b->inArena = true;
+    blocks.push_back(b);
+  }
+  for (int i = 0; i < src.blocks.size(); ++i)
+  {
+    copyItems(*src.blocks[i], blocks[i]->params, blocks[i]->blocks, blocks[i]);
+    blocks[i]->arenaData = true;
+  }
+}
+
+
+bool DataBlock::relocate()
+{
+  if (parent)
+    return false;
+
+  ArenaBuilder ab;
+  ab.measure(*this);
+  size_t size = ab.pos;
+
+  Tab<Param> newParams;
+  Tab<DataBlock *> newBlocks;
+  char *mem = size ? (char *)memalloc(size, midmem) : NULL;
+  if (mem)
+  {
+    ab.base = mem;
+    ab.pos = 0;
+    ab.copyItems(*this, newParams, newBlocks, this);
+  }
+
+  // contents are the same, so cached hash stays valid
+  bool hashValid = contentHashValid;
+  uint64_t hash = contentHash;
+  clearData();
+  params.swap(newParams);
+  blocks.swap(newBlocks);
+  arena = mem;
+  arenaData = mem != NULL;
+  contentHashValid = hashValid;
+  contentHash = hash;
+  return true;
+}
+
+
+void DataBlock::releaseArenaTabs()
+{
+  // string values are in arena too, so params must not free them
+  for (int i = 0; i < params.size(); ++i)
+    if (params[i].type == TYPE_STRING)
+      params[i].type = TYPE_NONE;
+  params.clear();
+  blocks.clear();
+  new (&params) Tab<Param>();
+  new (&blocks) Tab<DataBlock *>();
+}
+
+void DataBlock::detachArenaData()
+{
+  arenaData = false;
+  Tab<Param> newParams;
+  newParams.reserve(params.size());
+  for (int i = 0; i < params.size(); ++i)
+  {
+    newParams.emplace_back();
+    newParams.back().nameId = params[i].nameId;
+    newParams.back().setValueFrom(params[i]);
+  }
+  Tab<DataBlock *> newBlocks(blocks);
+
+  releaseArenaTabs();
+  params.swap(newParams);
+  blocks.swap(newBlocks);
+}
+
+
+void DataBlock::shrink()
+{
+  if (!arenaData)
+  {
+    params.shrink_to_fit();
+    blocks.shrink_to_fit();
+  }
+  for (int i = 0; i < blocks.size(); ++i)
+    blocks[i]->shrink();
+}
@@ -0,0 +1,145 @@
+// Copyright (C) Gaijin Games KFT.  All rights reserved.
+
+#include <stdio.h>
+
+#include "datablockMatch.h"
+
+
+struct DataBlock::DiffContext : DataBlock::NameMatcher
+{
+  DataBlockDiffCB &cb;
+  struct Pair
+  {
+    const DataBlock *a, *b;
+    int ord;
+  };
+  Tab<Pair> pairs; // stack of matched sub-block pairs waiting for recursion
+  String path;
+
+  DiffContext(DataBlockDiffCB &_cb) : cb(_cb) {}
+
+  void pushPath(const char *name, int ord, int &prev_len);
+  void popPath(int prev_len)
+  {
+    path.resize(prev_len + 1);
+    path.back() = '\0';
+  }
+};
+
+
+void DataBlock::DiffContext::pushPath(const char *name, int ord, int &prev_len)
+{
+  prev_len = path.length();
+  if (prev_len)
+    path.append("/", 1);
+  path.append(name ? name : "");
+  if (ord > 0)
+  {
+    char buf[16];
+    path.append(buf, snprintf(buf, sizeof(buf), "[%d]", ord));
+  }
+}
+
+
+void DataBlock::doDiff(const DataBlock &b, DiffContext &ctx) const
+{
+  const DataBlock &a = *this;
+
+  // params
+  auto pidA = [&](int i) { return a.params[i].nameId; };
+  auto pidB = [&](int i) { return b.params[i].nameId; };
+  bool ordDone = false;
+  auto reportParam = [&](DataBlockDiffCB::Kind kind, int ia, int ib) {
+    if (!ordDone)
+    {
+      ctx.calcOrdinals(ctx.ordA, a.params.size(), pidA);
+      ctx.calcOrdinals(ctx.ordB, b.params.size(), [&](int i) { return ctx.idB(pidB(i)); });
+      ordDone = true;
+    }
+    int prevLen;
+    if (ib >= 0)
+      ctx.pushPath(b.getName(b.params[ib].nameId), ctx.ordB[ib], prevLen);
+    else
+      ctx.pushPath(a.getName(a.params[ia].nameId), ctx.ordA[ia], prevLen);
+    ctx.cb.onParam(kind, ctx.path, ia >= 0 ? &a : NULL, ia, ib >= 0 ? &b : NULL, ib);
+    ctx.popPath(prevLen);
+  };
+
+  if (!ctx.match(a.params.size(), pidA, b.params.size(), pidB))
+  {
+    for (int i = 0; i < b.params.size(); ++i)
+      if (!isParamValueEqual(a.params[i], b.params[i]))
+        reportParam(DataBlockDiffCB::CHANGED, i, i);
+  }
+  else
+  {
+    // matchB/matchedA are overwritten by blocks matching, so report everything now
+    for (int i = 0; i < b.params.size(); ++i)
+    {
+      int ia = ctx.matchB[i];
+      if (ia < 0)
+        reportParam(DataBlockDiffCB::ADDED, -1, i);
+      else if (!isParamValueEqual(a.params[ia], b.params[i]))
+        reportParam(DataBlockDiffCB::CHANGED, ia, i);
+    }
+    for (int i = 0; i < a.params.size(); ++i)
+      if (!ctx.matchedA[i])
+        reportParam(DataBlockDiffCB::REMOVED, i, -1);
+  }
+
+  // sub-blocks
+  auto bidA = [&](int i) { return a.blocks[i]->nameId; };
+  auto bidB = [&](int i) { return b.blocks[i]->nameId; };
+  ctx.calcOrdinals(ctx.ordA, a.blocks.size(), bidA);
+  ctx.calcOrdinals(ctx.ordB, b.blocks.size(), [&](int i) { return ctx.idB(bidB(i)); });
+
+  int pairsBase = ctx.pairs.size();
+  if (!ctx.match(a.blocks.size(), bidA, b.blocks.size(), bidB))
+  {
+    for (int i = 0; i < b.blocks.size(); ++i)
+      ctx.pairs.push_back({a.blocks[i], b.blocks[i], ctx.ordB[i]});
+  }
+  else
+  {
+    int prevLen;
+    for (int i = 0; i < b.blocks.size(); ++i)
+    {
+      int ia = ctx.matchB[i];
+      if (ia >= 0)
+      {
+        ctx.pairs.push_back({a.blocks[ia], b.blocks[i], ctx.ordB[i]});
+        continue;
+      }
+      ctx.pushPath(b.blocks[i]->getBlockName(), ctx.ordB[i], prevLen);
+      ctx.cb.onBlock(DataBlockDiffCB::ADDED, ctx.path, NULL, b.blocks[i]);
+      ctx.popPath(prevLen);
+    }
+    for (int i = 0; i < a.blocks.size(); ++i)
+      if (!ctx.matchedA[i])
+      {
+        ctx.pushPath(a.blocks[i]->getBlockName(), ctx.ordA[i], prevLen);
+        ctx.cb.onBlock(DataBlockDiffCB::REMOVED, ctx.path, a.blocks[i], NULL);
+        ctx.popPath(prevLen);
+      }
+  }
+
+  // recurse into matched pairs; pairs stack may be reallocated by nested calls, so access it by index
+  int pairsEnd = ctx.pairs.size();
+  for (int i = pairsBase; i < pairsEnd; ++i)
+  {
+    DiffContext::Pair p = ctx.pairs[i];
+    int prevLen;
+    ctx.pushPath(p.b->getBlockName(), p.ord, prevLen);
+    p.a->doDiff(*p.b, ctx);
+    ctx.popPath(prevLen);
+  }
+  ctx.pairs.resize(pairsBase);
+}
+
+
+void DataBlock::diff(const DataBlock &b, DataBlockDiffCB &cb) const
+{
+  DiffContext ctx(cb);
+  ctx.init(nameMap, b.nameMap);
+  doDiff(b, ctx);
+}
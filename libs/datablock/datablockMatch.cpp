@@ -0,0 +1,65 @@
+// Copyright (C) Gaijin Games KFT.  All rights reserved.
+
+#include "datablockMatch.h"
+
+
+static unsigned hashName(const char *s)
+{
+  unsigned h = 2166136261u;
+  for (; *s; ++s)
+    h = (h ^ (unsigned char)*s) * 16777619u;
+  return h;
+}
+
+// builds B->A name id remap using temporary open addressing table over A names
+static void buildNameRemap(Tab<int> &remap, const NameMap &a, const NameMap &b, int first_unknown_id)
+{
+  int na = a.nameCount(), nb = b.nameCount();
+  unsigned tabSize = 16;
+  while (tabSize < unsigned(na) * 2)
+    tabSize <<= 1;
+  Tab<int> table;
+  table.resize(tabSize);
+  memset(table.data(), 0xFF, tabSize * sizeof(int));
+  for (int i = 0; i < na; ++i)
+  {
+    unsigned h = hashName(a.getName(i)) & (tabSize - 1);
+    while (table[h] >= 0)
+      h = (h + 1) & (tabSize - 1);
+    table[h] = i;
+  }
+
+  remap.resize(nb);
+  int nextUnknown = first_unknown_id;
+  for (int i = 0; i < nb; ++i)
+  {
+    const char *name = b.getName(i);
+    int found = -1;
+    for (unsigned h = hashName(name) & (tabSize - 1); table[h] >= 0; h = (h + 1) & (tabSize - 1))
+      if (strcmp(a.getName(table[h]), name) == 0)
+      {
+        found = table[h];
+        break;
+      }
+    remap[i] = found >= 0 ? found : nextUnknown++;
+  }
+}
+
+
+void DataBlock::NameMatcher::init(const NameMap *a, const NameMap *b, int id_reserve)
+{
+  int ids = a ? a->nameCount() : 0;
+  remapB.clear();
+  if (a != b && a && b)
+  {
+    buildNameRemap(remapB, *a, *b, ids + id_reserve);
+    ids += id_reserve + b->nameCount();
+  }
+  chainHead.resize(ids);
+  chainTail.resize(ids);
+  if (ids)
+  {
+    memset(chainHead.data(), 0xFF, ids * sizeof(int));
+    memset(chainTail.data(), 0xFF, ids * sizeof(int));
+  }
+}
@@ -0,0 +1,97 @@
+// Copyright (C) Gaijin Games KFT.  All rights reserved.
+#pragma once
+
+// internal header shared by DataBlock diff/patch code
+
+#include <string.h>
+
+#include <math/namemap.h>
+#include "datablock.h"
+
+
+// Pairs params/sub-blocks of two DataBlocks by name id and occurrence order,
+// e.g. 2nd "obj" block of A is paired with 2nd "obj" block of B.
+// When trees use different NameMaps, ids of B are remapped to ids of A once (names absent in A get unique ids
+// past A's range), so matching itself never touches strings.
+struct DataBlock::NameMatcher
+{
+  Tab<int> remapB;     // B name id -> A name id; empty when NameMap is shared
+  Tab<int> chainHead;  // per name id: first not yet matched A item
+  Tab<int> chainTail;  // per name id: last A item in chain
+  Tab<int> chainNext;  // per A item: next A item with the same name id
+  Tab<int> matchB;     // per B item: matched A item or -1
+  Tab<int> ordA, ordB; // per item occurrence index among same-named siblings
+  Tab<char> matchedA;
+
+  // id_reserve keeps range of ids after A's names free (for names added to A while matching)
+  void init(const NameMap *a, const NameMap *b, int id_reserve = 0);
+
+  int idB(int id) const { return (remapB.empty() || id < 0) ? id : remapB[id]; }
+
+  // fills matchB/matchedA; returns false when items are trivially paired 1:1 by position
+  template <typename IdA, typename IdB>
+  bool match(int na, IdA id_a, int nb, IdB id_b);
+
+  // ord[i] = number of preceding items with the same name id
+  template <typename Id>
+  void calcOrdinals(Tab<int> &ord, int n, Id id);
+};
+
+
+template <typename IdA, typename IdB>
+bool DataBlock::NameMatcher::match(int na, IdA id_a, int nb, IdB id_b)
+{
+  matchB.resize(nb);
+  matchedA.resize(na);
+
+  int i = 0, n = na < nb ? na : nb;
+  for (; i < n && id_a(i) == idB(id_b(i)); ++i)
+    matchB[i] = i;
+  if (i == na && i == nb)
+    return false;
+  memset(matchedA.data(), 0, na);
+  memset(matchedA.data(), 1, i);
+
+  // chain remaining A items by name id, then consume chains in B order
+  chainNext.resize(na);
+  for (int j = i; j < na; ++j)
+  {
+    int id = id_a(j);
+    chainNext[j] = -1;
+    if (id < 0)
+      continue;
+    if (chainHead[id] < 0)
+      chainHead[id] = j;
+    else
+      chainNext[chainTail[id]] = j;
+    chainTail[id] = j;
+  }
+  for (int j = i; j < nb; ++j)
+  {
+    int id = idB(id_b(j));
+    int a = id >= 0 ? chainHead[id] : -1;
+    matchB[j] = a;
+    if (a >= 0)
+    {
+      chainHead[id] = chainNext[a];
+      matchedA[a] = 1;
+    }
+  }
+  for (int j = i; j < na; ++j)
+    if (id_a(j) >= 0)
+      chainHead[id_a(j)] = chainTail[id_a(j)] = -1;
+  return true;
+}
+
+template <typename Id>
+void DataBlock::NameMatcher::calcOrdinals(Tab<int> &ord, int n, Id id)
+{
+  // chainTail is used as per-name counter here, it is all -1 between match() calls
+  ord.resize(n);
+  for (int i = 0; i < n; ++i)
+    if (id(i) >= 0)
+      ord[i] = ++chainTail[id(i)];
+  for (int i = 0; i < n; ++i)
+    if (id(i) >= 0)
+      chainTail[id(i)] = -1;
+}
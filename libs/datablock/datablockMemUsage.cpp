@@ -0,0 +1,119 @@
+// Copyright (C) Gaijin Games KFT.  All rights reserved.
+
+#include <string.h>
+
+#include <math/namemap.h>
+#include <memory/dag_mem.h>
+#include <memory/dag_memStat.h>
+#include <debug/dag_debug.h>
+#include "datablock.h"
+
+
+struct DataBlock::MemUsageContext
+{
+  MemUsage &usage;
+  MemUsageTop *top;
+  int topCount, topUsed = 0;
+
+  MemUsageContext(MemUsage &u, MemUsageTop *t, int tc) : usage(u), top(t), topCount(t ? tc : 0) {}
+
+  size_t chunk(IMemAlloc *m, const void *p)
+  {
+    if (!p)
+      return 0;
+    size_t sz = m->getSize((void *)p);
+    usage.heapBytes += sz;
+    usage.heapChunks++;
+    return sz;
+  }
+
+  void addTop(const DataBlock *blk, size_t own, size_t subtree);
+  size_t calc(const DataBlock &blk, bool root);
+};
+
+
+// keeps top[] sorted by ownBytes descending
+void DataBlock::MemUsageContext::addTop(const DataBlock *blk, size_t own, size_t subtree)
+{
+  if (topUsed == topCount && (!topCount || top[topUsed - 1].ownBytes >= own))
+    return;
+  int i = topUsed < topCount ? topUsed++ : topUsed - 1;
+  for (; i > 0 && top[i - 1].ownBytes < own; --i)
+    top[i] = top[i - 1];
+  top[i].blk = blk;
+  top[i].ownBytes = own;
+  top[i].subtreeBytes = subtree;
+}
+
+// returns heap bytes of block sub-tree
+size_t DataBlock::MemUsageContext::calc(const DataBlock &blk, bool root)
+{
+  usage.blocks++;
+  usage.params += blk.params.size();
+  usage.nodeBytes += sizeof(DataBlock);
+  usage.paramsUsed += blk.params.size() * sizeof(Param);
+  usage.paramsReserved += blk.params.capacity() * sizeof(Param);
+  usage.blockPtrsUsed += blk.blocks.size() * sizeof(DataBlock *);
+  usage.blockPtrsReserved += blk.blocks.capacity() * sizeof(DataBlock *);
+
+  // root object may live on stack or inside other object, so only its size is known;
+  // relocated data is a part of single arena chunk counted for root, so its own share is payload size
+  size_t own = (root || blk.inArena) ? sizeof(DataBlock) : chunk(defaultmem, &blk);
+  if (blk.arenaData)
+    own += blk.params.capacity() * sizeof(Param) + blk.blocks.capacity() * sizeof(DataBlock *);
+  else
+  {
+    own += chunk(dag::get_allocator(blk.params), blk.params.data());
+    own += chunk(dag::get_allocator(blk.blocks), blk.blocks.data());
+  }
+  for (int i = 0; i < blk.params.size(); ++i)
+    if (blk.params[i].type == TYPE_STRING && blk.params[i].value.s)
+    {
+      size_t len = strlen(blk.params[i].value.s) + 1;
+      usage.strings++;
+      usage.stringBytes += len;
+      own += blk.arenaData ? len : chunk(strmem, blk.params[i].value.s);
+    }
+
+  size_t subtree = own;
+  for (int i = 0; i < blk.blocks.size(); ++i)
+    subtree += calc(*blk.blocks[i], false);
+  addTop(&blk, own, subtree);
+  return subtree;
+}
+
+
+int DataBlock::calcMemUsage(MemUsage &usage, MemUsageTop *top, int top_count) const
+{
+  memset(&usage, 0, sizeof(usage));
+  MemUsageContext ctx(usage, top, top_count);
+  ctx.calc(*this, true);
+  ctx.chunk(midmem, arena);
+  if (nameMap && !parent)
+  {
+    usage.nameMapBytes = sizeof(NameMap) + nameMap->calcMemUsage(&usage.heapBytes, &usage.heapChunks);
+    ctx.chunk(defaultmem, nameMap);
+  }
+  return ctx.topUsed;
+}
+
+
+void DataBlock::dumpMemUsage(int top_count) const
+{
+  MemUsage u;
+  MemUsageTop top[32];
+  int n = calcMemUsage(u, top, top_count < 32 ? top_count : 32);
+
+  size_t total = dagor_memory_stat::get_memory_allocated();
+  debug("DataBlock mem usage: %d blocks, %d params, %d strings; heap %zu bytes in %d chunks (%.2f%% of %zu allocated)",
+    u.blocks, u.params, u.strings, u.heapBytes, u.heapChunks, total ? u.heapBytes * 100.0 / total : 0.0, total);
+  debug("  nodes %zu, params %zu/%zu, block ptrs %zu/%zu, strings %zu, names %zu; used %zu, wasted %zu", u.nodeBytes,
+    u.paramsUsed, u.paramsReserved, u.blockPtrsUsed, u.blockPtrsReserved, u.stringBytes, u.nameMapBytes, u.usedBytes(),
+    u.wastedBytes());
+  char path[256];
+  for (int i = 0; i < n; ++i)
+  {
+    top[i].blk->getBlockPath(path, sizeof(path));
+    debug("  %8zu own, %10zu subtree  /%s", top[i].ownBytes, top[i].subtreeBytes, path);
+  }
+}
@@ -0,0 +1,228 @@
+// Copyright (C) Gaijin Games KFT.  All rights reserved.
+
+#include "datablockMatch.h"
+
+
+static const char *MARKER_DELETE = "__delete";
+static const char *MARKER_OVERRIDE = "__override";
+
+
+// Items of override tree are paired with base items by NameMatcher; override names missing in base are added
+// to base NameMap only when item is actually copied, and remap is updated so later matching sees real ids.
+struct DataBlock::MergeContext : DataBlock::NameMatcher
+{
+  NameMap &names;
+  const NameMap *overNames;
+  int flags;
+  Tab<int> baseIds; // override name id -> base name id, or -1 when name is not added to base yet
+  int deleteId = -1, overrideId = -1;
+  Tab<int> delIds;
+  struct Pair
+  {
+    DataBlock *a;
+    const DataBlock *b;
+  };
+  Tab<Pair> pairs; // stack of paired sub-blocks waiting for recursion
+
+  MergeContext(NameMap &base_names, const NameMap *over_names, int f) : names(base_names), overNames(over_names), flags(f) {}
+
+  void init();
+  int baseId(int over_id);
+  bool isMarker(int over_id) const { return over_id >= 0 && (over_id == deleteId || over_id == overrideId); }
+  bool isOverride(const DataBlock &b) const;
+
+  void copyContents(DataBlock &a, const DataBlock &b);
+  void applyDeletes(DataBlock &a, const DataBlock &b);
+  void mergeBlock(DataBlock &a, const DataBlock &b);
+};
+
+
+void DataBlock::MergeContext::init()
+{
+  // reserve id range for names that will be added to base, so they never clash with ids of unknown names
+  int overCount = overNames ? overNames->nameCount() : 0;
+  NameMatcher::init(&names, overNames, overCount);
+  if (overNames != &names)
+  {
+    int baseCount = names.nameCount();
+    baseIds.resize(overCount);
+    for (int i = 0; i < overCount; ++i)
+      baseIds[i] = remapB[i] < baseCount ? remapB[i] : -1;
+  }
+  if (!(flags & MERGE_IGNORE_MARKERS) && overNames)
+  {
+    deleteId = overNames->getNameId(MARKER_DELETE);
+    overrideId = overNames->getNameId(MARKER_OVERRIDE);
+  }
+}
+
+int DataBlock::MergeContext::baseId(int over_id)
+{
+  if (baseIds.empty() || over_id < 0)
+    return over_id;
+  if (baseIds[over_id] < 0)
+  {
+    baseIds[over_id] = names.addNameId(overNames->getName(over_id));
+    remapB[over_id] = baseIds[over_id];
+  }
+  return baseIds[over_id];
+}
+
+bool DataBlock::MergeContext::isOverride(const DataBlock &b) const
+{
+  if (overrideId < 0)
+    return false;
+  for (int i = 0; i < b.params.size(); ++i)
+    if (b.params[i].nameId == overrideId && b.params[i].type == TYPE_BOOL && b.params[i].value.b)
+      return true;
+  return false;
+}
+
+
+// appends copies of override block params and sub-blocks (except markers) to base block
+void DataBlock::MergeContext::copyContents(DataBlock &a, const DataBlock &b)
+{
+  a.invalidateHash();
+  a.params.reserve(a.params.size() + b.params.size());
+  for (int i = 0; i < b.params.size(); ++i)
+  {
+    const Param &p = b.params[i];
+    if (isMarker(p.nameId))
+      continue;
+    a.params.emplace_back();
+    Param &np = a.params.back();
+    np.nameId = baseId(p.nameId);
+    np.setValueFrom(p);
+  }
+  a.blocks.reserve(a.blocks.size() + b.blocks.size());
+  for (int i = 0; i < b.blocks.size(); ++i)
+  {
+    DataBlock *nb = new DataBlock(&a);
+    nb->nameId = baseId(b.blocks[i]->nameId);
+    a.blocks.push_back(nb);
+    copyContents(*nb, *b.blocks[i]);
+  }
+}
+
+void DataBlock::MergeContext::applyDeletes(DataBlock &a, const DataBlock &b)
+{
+  delIds.clear();
+  for (int i = 0; i < b.params.size(); ++i)
+    if (b.params[i].nameId == deleteId && b.params[i].type == TYPE_STRING)
+    {
+      int id = names.getNameId(b.params[i].value.s);
+      if (id >= 0)
+        delIds.push_back(id);
+    }
+  if (delIds.empty())
+    return;
+  auto isDeleted = [&](int id) {
+    for (int i = 0; i < delIds.size(); ++i)
+      if (delIds[i] == id)
+        return true;
+    return false;
+  };
+
+  a.removeParamsIf([&](int i) { return isDeleted(a.params[i].nameId); });
+  a.removeBlocksIf([&](int i) { return isDeleted(a.blocks[i]->nameId); });
+}
+
+void DataBlock::MergeContext::mergeBlock(DataBlock &a, const DataBlock &b)
+{
+  if (deleteId >= 0)
+    applyDeletes(a, b);
+
+  // params
+  if (flags & MERGE_APPEND_PARAMS)
+  {
+    for (int j = 0; j < b.params.size(); ++j)
+      if (!isMarker(b.params[j].nameId))
+      {
+        a.invalidateHash();
+        a.params.emplace_back();
+        Param &np = a.params.back();
+        np.nameId = baseId(b.params[j].nameId);
+        np.setValueFrom(b.params[j]);
+      }
+  }
+  else
+  {
+    match(
+      a.params.size(), [&](int i) { return a.params[i].nameId; }, b.params.size(), [&](int i) { return b.params[i].nameId; });
+    // matchB refers to original base params only, appended ones go after them
+    for (int j = 0; j < b.params.size(); ++j)
+    {
+      const Param &p = b.params[j];
+      if (isMarker(p.nameId))
+        continue;
+      int ia = matchB[j];
+      if (ia >= 0 && isParamValueEqual(a.params[ia], p))
+        continue;
+      a.invalidateHash();
+      if (ia >= 0)
+        a.params[ia].setValueFrom(p);
+      else
+      {
+        a.params.emplace_back();
+        Param &np = a.params.back();
+        np.nameId = baseId(p.nameId);
+        np.setValueFrom(p);
+      }
+    }
+  }
+
+  // sub-blocks
+  if (flags & MERGE_APPEND_BLOCKS)
+  {
+    for (int j = 0; j < b.blocks.size(); ++j)
+    {
+      DataBlock *nb = new DataBlock(&a);
+      nb->nameId = baseId(b.blocks[j]->nameId);
+      a.addBlock(nb);
+      copyContents(*nb, *b.blocks[j]);
+    }
+    return;
+  }
+
+  int pairsBase = pairs.size();
+  match(
+    a.blocks.size(), [&](int i) { return a.blocks[i]->nameId; }, b.blocks.size(), [&](int i) { return b.blocks[i]->nameId; });
+  for (int j = 0; j < b.blocks.size(); ++j)
+  {
+    const DataBlock &sub = *b.blocks[j];
+    int ia = matchB[j];
+    if (ia < 0)
+    {
+      DataBlock *nb = new DataBlock(&a);
+      nb->nameId = baseId(sub.nameId);
+      a.addBlock(nb);
+      copyContents(*nb, sub);
+    }
+    else if ((flags & MERGE_REPLACE_BLOCKS) || isOverride(sub))
+    {
+      a.blocks[ia]->clearData();
+      copyContents(*a.blocks[ia], sub);
+    }
+    else
+      pairs.push_back({a.blocks[ia], &sub});
+  }
+
+  // matcher state is reused by nested calls, so recurse only after this block is done
+  int pairsEnd = pairs.size();
+  for (int i = pairsBase; i < pairsEnd; ++i)
+  {
+    Pair p = pairs[i];
+    mergeBlock(*p.a, *p.b);
+  }
+  pairs.resize(pairsBase);
+}
+
+
+void DataBlock::mergeFrom(const DataBlock &over, int flags)
+{
+  if (&over == this || !nameMap)
+    return;
+  MergeContext ctx(*nameMap, over.nameMap, flags);
+  ctx.init();
+  ctx.mergeBlock(*this, over);
+}
@@ -0,0 +1,652 @@
+// Copyright (C) Gaijin Games KFT.  All rights reserved.
+
+#include <limits.h>
+#include <EASTL/algorithm.h>
+#include <memory/dag_mem.h>
+#include <bitstream/bitstream.h>
+#include "datablockMatch.h"
+
+
+// Patch layout:
+//   uint8 version
+//   ops of root block, terminated by OP_END
+//
+// Ops address params/sub-blocks by their current index in the block being patched;
+// OP_ENTER_BLOCK makes sub-block current until matching OP_END.
+// Within a block all removals come first (in descending index order), then insertions/updates
+// in ascending index order, so every index is final at the moment it is written.
+//
+// Names are written as VLQ reference to names seen so far in the patch;
+// reference equal to number of seen names means new name follows (VLQ length and chars).
+// Values are written as 4-bit type followed by type-specific payload.
+enum
+{
+  PATCH_VERSION = 1,
+  OP_BITS = 3,
+  TYPE_BITS = 4,
+};
+
+enum PatchOp
+{
+  OP_END,
+  OP_ENTER_BLOCK,   // idx, ops..., OP_END
+  OP_SET_PARAM,     // idx, value
+  OP_INSERT_PARAMS, // idx, count, count x (name, value)
+  OP_REMOVE_PARAMS, // idx, count
+  OP_INSERT_BLOCKS, // idx, count, count x (name, param count, params, block count, blocks)
+  OP_REMOVE_BLOCKS, // idx, count
+};
+
+
+struct DataBlock::PatchWriter : DataBlock::NameMatcher
+{
+  danet::BitStream &patch;
+  Tab<int> nameRef; // B name id -> name reference in patch, or -1
+  int namesWritten = 0;
+  Tab<int> lisTail, lisPrev;
+  Tab<char> keptB; // per B item: matched item that stays in place
+  struct Pair
+  {
+    const DataBlock *a, *b;
+    int idx;
+  };
+  Tab<Pair> pairs; // stack of kept sub-block pairs waiting for recursion
+
+  PatchWriter(danet::BitStream &p) : patch(p) {}
+
+  void writeOp(int op)
+  {
+    uint8_t o = op;
+    patch.WriteBits(&o, OP_BITS);
+  }
+  void writeUInt(int v) { patch.WriteCompressed((uint32_t)v); }
+  void writeName(const DataBlock &b, int name_id);
+  void writeValue(const Param &p);
+  void writeParam(const DataBlock &b, const Param &p)
+  {
+    writeName(b, p.nameId);
+    writeValue(p);
+  }
+  void writeSubtree(const DataBlock &b);
+
+  void calcKept(int na, int nb);
+  void writeRemovals(int op, int na);
+  template <typename IdA, typename IdB, typename OnKept, typename WriteItem>
+  void writeListOps(int op_insert, int op_remove, int na, IdA id_a, int nb, IdB id_b, OnKept on_kept, WriteItem write_item);
+  bool writeBlockOps(const DataBlock &a, const DataBlock &b);
+};
+
+
+void DataBlock::PatchWriter::writeName(const DataBlock &b, int name_id)
+{
+  int &ref = nameRef[name_id];
+  if (ref >= 0)
+  {
+    writeUInt(ref);
+    return;
+  }
+  ref = namesWritten++;
+  writeUInt(ref);
+  const char *name = b.getName(name_id);
+  uint32_t len = strlen(name);
+  patch.WriteCompressed(len);
+  patch.Write(name, len);
+}
+
+void DataBlock::PatchWriter::writeValue(const Param &p)
+{
+  uint8_t type = p.type;
+  patch.WriteBits(&type, TYPE_BITS);
+  switch (p.type)
+  {
+    case TYPE_STRING:
+    {
+      uint32_t len = strlen(p.value.s);
+      patch.WriteCompressed(len);
+      patch.Write(p.value.s, len);
+    }
+    break;
+    case TYPE_INT: patch.WriteCompressed((int32_t)p.value.i); break;
+    case TYPE_REAL: patch.Write(p.value.r); break;
+    case TYPE_POINT2: patch.WriteArray(&p.value.p2.x, 2); break;
+    case TYPE_POINT3: patch.WriteArray(&p.value.p3.x, 3); break;
+    case TYPE_POINT4: patch.WriteArray(&p.value.p4.x, 4); break;
+    case TYPE_IPOINT2:
+      patch.WriteCompressed((int32_t)p.value.ip2.x);
+      patch.WriteCompressed((int32_t)p.value.ip2.y);
+      break;
+    case TYPE_IPOINT3:
+      patch.WriteCompressed((int32_t)p.value.ip3.x);
+      patch.WriteCompressed((int32_t)p.value.ip3.y);
+      patch.WriteCompressed((int32_t)p.value.ip3.z);
+      break;
+    case TYPE_BOOL: patch.Write(p.value.b); break;
+    case TYPE_E3DCOLOR: patch.Write((uint32_t)p.value.c.u); break;
+    case TYPE_MATRIX: patch.WriteArray(&p.value.tm.m[0][0], 12); break;
+  }
+}
+
+void DataBlock::PatchWriter::writeSubtree(const DataBlock &b)
+{
+  writeName(b, b.nameId);
+  writeUInt(b.params.size());
+  for (int i = 0; i < b.params.size(); ++i)
+    writeParam(b, b.params[i]);
+  writeUInt(b.blocks.size());
+  for (int i = 0; i < b.blocks.size(); ++i)
+    writeSubtree(*b.blocks[i]);
+}
+
+
+// Keeps longest subsequence of matched pairs that goes in the same order in A and B,
+// the rest of A items are removed and the rest of B items are inserted.
+// Results in keptB (per B item) and matchedA (per A item).
+void DataBlock::PatchWriter::calcKept(int na, int nb)
+{
+  keptB.resize(nb);
+  int last = -1;
+  bool ordered = true;
+  for (int j = 0; j < nb && ordered; ++j)
+    if (matchB[j] >= 0)
+    {
+      ordered = matchB[j] > last;
+      last = matchB[j];
+    }
+  if (ordered)
+  {
+    for (int j = 0; j < nb; ++j)
+      keptB[j] = matchB[j] >= 0;
+    return;
+  }
+
+  // patience sorting: lisTail[k] is B item ending increasing run of length k+1 with the smallest A index
+  lisTail.clear();
+  lisPrev.resize(nb);
+  for (int j = 0; j < nb; ++j)
+  {
+    int ia = matchB[j];
+    if (ia < 0)
+      continue;
+    int lo = 0, hi = lisTail.size();
+    while (lo < hi)
+    {
+      int mid = (lo + hi) >> 1;
+      if (matchB[lisTail[mid]] < ia)
+        lo = mid + 1;
+      else
+        hi = mid;
+    }
+    lisPrev[j] = lo > 0 ? lisTail[lo - 1] : -1;
+    if (lo == lisTail.size())
+      lisTail.push_back(j);
+    else
+      lisTail[lo] = j;
+  }
+
+  memset(keptB.data(), 0, nb);
+  memset(matchedA.data(), 0, na);
+  for (int j = lisTail.empty() ? -1 : lisTail.back(); j >= 0; j = lisPrev[j])
+  {
+    keptB[j] = 1;
+    matchedA[matchB[j]] = 1;
+  }
+}
+
+void DataBlock::PatchWriter::writeRemovals(int op, int na)
+{
+  for (int i = na - 1; i >= 0;)
+  {
+    if (matchedA[i])
+    {
+      --i;
+      continue;
+    }
+    int last = i;
+    while (i >= 0 && !matchedA[i])
+      --i;
+    writeOp(op);
+    writeUInt(i + 1);
+    writeUInt(last - i);
+  }
+}
+
+template <typename IdA, typename IdB, typename OnKept, typename WriteItem>
+void DataBlock::PatchWriter::writeListOps(int op_insert, int op_remove, int na, IdA id_a, int nb, IdB id_b, OnKept on_kept,
+  WriteItem write_item)
+{
+  bool reordered = match(na, id_a, nb, id_b);
+  if (reordered)
+  {
+    calcKept(na, nb);
+    writeRemovals(op_remove, na);
+  }
+  for (int j = 0; j < nb;)
+  {
+    if (!reordered || keptB[j])
+    {
+      on_kept(matchB[j], j);
+      ++j;
+      continue;
+    }
+    int first = j;
+    while (j < nb && !keptB[j])
+      ++j;
+    writeOp(op_insert);
+    writeUInt(first);
+    writeUInt(j - first);
+    for (int k = first; k < j; ++k)
+      write_item(k);
+  }
+}
+
+bool DataBlock::PatchWriter::writeBlockOps(const DataBlock &a, const DataBlock &b)
+{
+  uint32_t start = patch.GetWriteOffset();
+
+  writeListOps(
+    OP_INSERT_PARAMS, OP_REMOVE_PARAMS, a.params.size(), [&](int i) { return a.params[i].nameId; }, b.params.size(),
+    [&](int i) { return b.params[i].nameId; },
+    [&](int ia, int j) {
+      if (isParamValueEqual(a.params[ia], b.params[j]))
+        return;
+      writeOp(OP_SET_PARAM);
+      writeUInt(j);
+      writeValue(b.params[j]);
+    },
+    [&](int j) { writeParam(b, b.params[j]); });
+
+  int pairsBase = pairs.size();
+  writeListOps(
+    OP_INSERT_BLOCKS, OP_REMOVE_BLOCKS, a.blocks.size(), [&](int i) { return a.blocks[i]->nameId; }, b.blocks.size(),
+    [&](int i) { return b.blocks[i]->nameId; }, [&](int ia, int j) { pairs.push_back({a.blocks[ia], b.blocks[j], j}); },
+    [&](int j) { writeSubtree(*b.blocks[j]); });
+
+  // recurse into kept sub-blocks; unchanged ones are rolled back, pairs stack is accessed by index as it grows
+  int pairsEnd = pairs.size();
+  for (int i = pairsBase; i < pairsEnd; ++i)
+  {
+    Pair p = pairs[i];
+    uint32_t pos = patch.GetWriteOffset();
+    writeOp(OP_ENTER_BLOCK);
+    writeUInt(p.idx);
+    if (writeBlockOps(*p.a, *p.b))
+      writeOp(OP_END);
+    else
+      patch.SetWriteOffset(pos);
+  }
+  pairs.resize(pairsBase);
+
+  return patch.GetWriteOffset() != start;
+}
+
+
+bool DataBlock::makePatch(const DataBlock &to, danet::BitStream &patch) const
+{
+  PatchWriter w(patch);
+  w.init(nameMap, to.nameMap);
+  int namesB = to.nameMap ? to.nameMap->nameCount() : 0;
+  w.nameRef.resize(namesB);
+  if (namesB)
+    memset(w.nameRef.data(), 0xFF, namesB * sizeof(int));
+
+  patch.Write((uint8_t)PATCH_VERSION);
+  bool changed = w.writeBlockOps(*this, to);
+  w.writeOp(OP_END);
+  return changed;
+}
+
+
+struct DataBlock::PatchReader
+{
+  const danet::BitStream &patch;
+  NameMap &names;
+  Tab<int> nameIds; // name reference in patch -> name id in patched tree
+  Tab<char> str;
+
+  PatchReader(const danet::BitStream &p, NameMap &nm) : patch(p), names(nm) {}
+
+  bool readOp(int &op)
+  {
+    uint8_t o = 0;
+    if (!patch.ReadBits(&o, OP_BITS))
+      return false;
+    op = o;
+    return true;
+  }
+  bool readUInt(int &v)
+  {
+    uint32_t u = 0;
+    if (!patch.ReadCompressed(u) || u > INT_MAX)
+      return false;
+    v = u;
+    return true;
+  }
+  bool readLength(uint32_t &len) { return patch.ReadCompressed(len) && len <= patch.GetNumberOfUnreadBits() / 8; }
+  bool readName(int &name_id);
+  bool readValue(Param &p);
+  bool readParam(Param &p) { return readName(p.nameId) && readValue(p); }
+  DataBlock *readSubtree(DataBlock &parent);
+  bool readBlockOps(DataBlock &blk);
+
+  // Ops on one list (params or sub-blocks) of block, collected to rebuild the list in single pass when block ends.
+  // Writer orders them as removals in descending index order, then insertions and value sets in ascending one;
+  // op out of this order makes collected ops applied first, so any patch gives same result as ops applied one by one.
+  template <typename T>
+  struct ListEdits
+  {
+    struct Run
+    {
+      int at, cnt; // removal: list index; insertion: number of kept items before it
+      int first;   // insertion: first one in items (number of items inserted before it)
+    };
+    Tab<Run> removals;   // descending, so their indices are not shifted by each other
+    Tab<Run> insertions; // ascending
+    Tab<T> items;        // inserted ones
+    Tab<int> setAt;      // kept items with new values (params only), ascending
+    Tab<T> setItems;
+    int removed = 0;
+    int orderPos = 0; // lowest index next insertion or set may have without applying collected ops
+
+    ~ListEdits()
+    {
+      if constexpr (eastl::is_same_v<T, DataBlock *>) // not applied because of malformed patch
+        for (DataBlock *sub : items)
+          deleteSubBlock(sub);
+    }
+
+    // number of items in list with collected ops applied
+    int size(const Tab<T> &list) const { return list.size() - removed + items.size(); }
+    void remove(Tab<T> &list, int idx, int cnt)
+    {
+      if (!insertions.empty() || !setAt.empty() || (!removals.empty() && idx + cnt > removals.back().at))
+        apply(list);
+      if (!cnt)
+        return;
+      removals.push_back({idx, cnt, 0});
+      removed += cnt;
+    }
+    // items of insertion are added to 'items' between these calls
+    int beginInsert(Tab<T> &list, int idx)
+    {
+      if (idx < orderPos)
+        apply(list);
+      return items.size();
+    }
+    void endInsert(int idx, int first)
+    {
+      int cnt = items.size() - first;
+      insertions.push_back({idx - first, cnt, first});
+      orderPos = idx + cnt;
+    }
+    void set(Tab<T> &list, int idx, T &&value);
+    void apply(Tab<T> &list);
+  };
+  bool readBlockOps(DataBlock &blk, ListEdits<Param> &params, ListEdits<DataBlock *> &blocks);
+};
+
+
+template <typename T>
+void DataBlock::PatchReader::ListEdits<T>::set(Tab<T> &list, int idx, T &&value)
+{
+  if (idx < orderPos)
+  {
+    const Run *last = insertions.empty() ? NULL : &insertions.back();
+    if (last && idx >= last->at + last->first && idx < last->at + last->first + last->cnt) // item of last insertion
+    {
+      value.nameId = items[idx - last->at].nameId;
+      items[idx - last->at] = eastl::move(value);
+      return;
+    }
+    apply(list);
+  }
+  setAt.push_back(idx - items.size());
+  setItems.push_back(eastl::move(value));
+  orderPos = idx + 1;
+}
+
+template <typename T>
+void DataBlock::PatchReader::ListEdits<T>::apply(Tab<T> &list)
+{
+  if (removals.empty() && insertions.empty() && setAt.empty())
+    return;
+
+  // removals and sets: kept items are compacted
+  int n = list.size(), w = 0;
+  for (int i = 0, r = removals.size() - 1, si = 0; i < n; ++i)
+  {
+    while (r >= 0 && i >= removals[r].at + removals[r].cnt)
+      --r;
+    if (r >= 0 && i >= removals[r].at)
+    {
+      if constexpr (eastl::is_same_v<T, DataBlock *>)
+        deleteSubBlock(list[i]);
+      continue;
+    }
+    if (w != i)
+      list[w] = eastl::move(list[i]);
+    if constexpr (eastl::is_same_v<T, Param>)
+      if (si < setAt.size() && setAt[si] == w)
+      {
+        int nameId = list[w].nameId;
+        list[w] = eastl::move(setItems[si++]); // old value goes to setItems and is freed with it
+        list[w].nameId = nameId;
+      }
+    ++w;
+  }
+  list.erase(list.begin() + w, list.end());
+
+  // insertions: kept items are moved to their final places from the end
+  if (!items.empty())
+  {
+    int src = w, dst = w + items.size();
+    list.resize(dst);
+    for (int r = insertions.size() - 1; r >= 0; --r)
+    {
+      const Run &run = insertions[r];
+      while (src > run.at)
+        list[--dst] = eastl::move(list[--src]);
+      for (int k = run.cnt - 1; k >= 0; --k)
+        list[--dst] = eastl::move(items[run.first + k]);
+    }
+  }
+
+  removals.clear();
+  insertions.clear();
+  items.clear();
+  setAt.clear();
+  setItems.clear();
+  removed = orderPos = 0;
+}
+
+
+bool DataBlock::PatchReader::readName(int &name_id)
+{
+  int ref;
+  if (!readUInt(ref) || ref > nameIds.size())
+    return false;
+  if (ref < nameIds.size())
+  {
+    name_id = nameIds[ref];
+    return true;
+  }
+  uint32_t len;
+  if (!readLength(len))
+    return false;
+  str.resize(len + 1);
+  if (!patch.Read(str.data(), len))
+    return false;
+  str[len] = '\0';
+  name_id = names.addNameId(str.data());
+  nameIds.push_back(name_id);
+  return true;
+}
+
+bool DataBlock::PatchReader::readValue(Param &p)
+{
+  uint8_t type = 0;
+  if (!patch.ReadBits(&type, TYPE_BITS))
+    return false;
+  bool ok = true;
+  switch (type)
+  {
+    case TYPE_STRING:
+    {
+      uint32_t len;
+      if (!readLength(len))
+        return false;
+      char *s = (char *)memalloc(len + 1, strmem);
+      if (!patch.Read(s, len))
+      {
+        memfree(s, strmem);
+        return false;
+      }
+      s[len] = '\0';
+      p.value.s = s;
+    }
+    break;
+    case TYPE_INT: ok = patch.ReadCompressed((int32_t &)p.value.i); break;
+    case TYPE_REAL: ok = patch.Read(p.value.r); break;
+    case TYPE_POINT2: ok = patch.ReadArray(&p.value.p2.x, 2); break;
+    case TYPE_POINT3: ok = patch.ReadArray(&p.value.p3.x, 3); break;
+    case TYPE_POINT4: ok = patch.ReadArray(&p.value.p4.x, 4); break;
+    case TYPE_IPOINT2:
+      ok = patch.ReadCompressed((int32_t &)p.value.ip2.x) && patch.ReadCompressed((int32_t &)p.value.ip2.y);
+      break;
+    case TYPE_IPOINT3:
+      ok = patch.ReadCompressed((int32_t &)p.value.ip3.x) && patch.ReadCompressed((int32_t &)p.value.ip3.y) &&
+           patch.ReadCompressed((int32_t &)p.value.ip3.z);
+      break;
+    case TYPE_BOOL: ok = patch.Read(p.value.b); break;
+    case TYPE_E3DCOLOR: ok = patch.Read(p.value.c.u); break;
+    case TYPE_MATRIX: ok = patch.ReadArray(&p.value.tm.m[0][0], 12); break;
+    default: return false;
+  }
+  if (ok)
+    p.type = type;
+  return ok;
+}
+
+DataBlock *DataBlock::PatchReader::readSubtree(DataBlock &parent)
+{
+  DataBlock *blk = new DataBlock(&parent);
+  int np, nb;
+  bool ok = readName(blk->nameId) && readUInt(np);
+  for (int i = 0; ok && i < np; ++i)
+  {
+    blk->params.emplace_back();
+    ok = readParam(blk->params.back());
+  }
+  ok = ok && readUInt(nb);
+  for (int i = 0; ok && i < nb; ++i)
+  {
+    DataBlock *sub = readSubtree(*blk);
+    ok = sub != NULL;
+    if (ok)
+      blk->blocks.push_back(sub);
+  }
+  if (ok)
+    return blk;
+  deleteSubBlock(blk);
+  return NULL;
+}
+
+bool DataBlock::PatchReader::readBlockOps(DataBlock &blk)
+{
+  ListEdits<Param> params;
+  ListEdits<DataBlock *> blocks;
+  if (!readBlockOps(blk, params, blocks))
+    return false; // collected ops are dropped, ones applied before are kept
+  params.apply(blk.params);
+  blocks.apply(blk.blocks);
+  return true;
+}
+
+bool DataBlock::PatchReader::readBlockOps(DataBlock &blk, ListEdits<Param> &params, ListEdits<DataBlock *> &blocks)
+{
+  for (;;)
+  {
+    int op, idx, cnt;
+    if (!readOp(op))
+      return false;
+    if (op == OP_END)
+      return true;
+    if (!readUInt(idx))
+      return false;
+    if (op != OP_ENTER_BLOCK)
+      blk.invalidateHash();
+
+    switch (op)
+    {
+      case OP_ENTER_BLOCK:
+        blocks.apply(blk.blocks); // index is final one
+        if (idx >= blk.blocks.size() || !readBlockOps(*blk.blocks[idx]))
+          return false;
+        break;
+
+      case OP_SET_PARAM:
+      {
+        if (idx >= params.size(blk.params))
+          return false;
+        Param p;
+        if (!readValue(p))
+          return false;
+        params.set(blk.params, idx, eastl::move(p));
+      }
+      break;
+
+      case OP_INSERT_PARAMS:
+      {
+        if (idx > params.size(blk.params) || !readUInt(cnt))
+          return false;
+        int first = params.beginInsert(blk.params, idx);
+        for (int i = 0; i < cnt; ++i)
+        {
+          params.items.emplace_back();
+          if (!readParam(params.items.back()))
+            return false;
+        }
+        params.endInsert(idx, first);
+      }
+      break;
+
+      case OP_INSERT_BLOCKS:
+      {
+        if (idx > blocks.size(blk.blocks) || !readUInt(cnt))
+          return false;
+        int first = blocks.beginInsert(blk.blocks, idx);
+        for (int i = 0; i < cnt; ++i)
+        {
+          DataBlock *sub = readSubtree(blk);
+          if (!sub)
+            return false;
+          blocks.items.push_back(sub);
+        }
+        blocks.endInsert(idx, first);
+      }
+      break;
+
+      case OP_REMOVE_PARAMS:
+        if (idx > params.size(blk.params) || !readUInt(cnt) || cnt > params.size(blk.params) - idx)
+          return false;
+        params.remove(blk.params, idx, cnt);
+        break;
+
+      case OP_REMOVE_BLOCKS:
+        if (idx > blocks.size(blk.blocks) || !readUInt(cnt) || cnt > blocks.size(blk.blocks) - idx)
+          return false;
+        blocks.remove(blk.blocks, idx, cnt);
+        break;
+
+      default: return false;
+    }
+  }
+}
+
+bool DataBlock::applyPatch(const danet::BitStream &patch)
+{
+  uint8_t version = 0;
+  if (!patch.Read(version) || version != PATCH_VERSION || !nameMap)
+    return false;
+  PatchReader r(patch, *nameMap);
+  return r.readBlockOps(*this);
+}
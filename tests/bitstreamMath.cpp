@@ -0,0 +1,232 @@
+#include "test.h"
+#include <bitstream/bitstreamMath.h>
+#include <bitstream/bitstreamSegmented.h>
+#include <memory/dag_mem.h>
+#include <math.h>
+#include <string.h>
+#include <vector>
+
+void (*dgs_fatal_report)(const char *, const char *) = nullptr;
+
+// Round trips of compressed math types stay within error bounds documented in bitstreamMath.h, at several precisions.
+// Bounds for precisions not given there are scaled by 2 per bit from documented ones.
+
+static double max_unit_vector_error_deg(uint32_t bits) { return 0.96 * ldexp(1.0, 8 - int(bits)); } // 0.06 at 12 bits
+static double max_quat_error_deg(uint32_t bits) { return 0.24 * ldexp(1.0, 10 - int(bits)); }       // 0.06 at 12 bits
+static double max_pos_error(float box_size, uint32_t bits) { return box_size / (ldexp(1.0, bits + 1) - 2); }
+
+// angles from chord length of vectors normalized in double, acos of dot product is too coarse near 1
+static double angle_deg(const Point3 &a, const Point3 &b) {
+  double la = length(DPoint3(a)), lb = length(DPoint3(b));
+  return 2 * asin(min(length(DPoint3(a) / la - DPoint3(b) / lb) / 2, 1.0)) * RAD_TO_DEG;
+}
+
+// rotation angle between rotations of quaternions, q and -q are same rotation
+static double rotation_error_deg(const Quat &a, const Quat &b) {
+  double qa[4] = {a.x, a.y, a.z, a.w}, qb[4] = {b.x, b.y, b.z, b.w}, la = 0, lb = 0, dot = 0;
+  for (int i = 0; i < 4; ++i) {
+    la += qa[i] * qa[i];
+    lb += qb[i] * qb[i];
+    dot += qa[i] * qb[i];
+  }
+  double chordSq = 0, s = dot < 0 ? -1 : 1;
+  for (int i = 0; i < 4; ++i)
+    chordSq += (qa[i] / sqrt(la) - s * qb[i] / sqrt(lb)) * (qa[i] / sqrt(la) - s * qb[i] / sqrt(lb));
+  return 4 * asin(min(sqrt(chordSq) / 2, 1.0)) * RAD_TO_DEG;
+}
+
+static Point3 random_dir(TestRng &rng) {
+  for (;;) {
+    Point3 p(rng.uniform(-1, 1), rng.uniform(-1, 1), rng.uniform(-1, 1));
+    float l = length(p);
+    if (l > 0.01f && l <= 1)
+      return p / l;
+  }
+}
+
+static Quat random_quat(TestRng &rng) {
+  for (;;) {
+    Quat q(rng.uniform(-1, 1), rng.uniform(-1, 1), rng.uniform(-1, 1), rng.uniform(-1, 1));
+    float l = sqrtf(q.x * q.x + q.y * q.y + q.z * q.z + q.w * q.w);
+    if (l > 0.01f && l <= 1)
+      return Quat(q.x / l, q.y / l, q.z / l, q.w / l);
+  }
+}
+
+template <typename W, typename R>
+static bool round_trip(const W &w, const R &r) {
+  danet::BitStream bs;
+  bs.Write(w);
+  return bs.Read(r) && !bs.GetNumberOfUnreadBits();
+}
+
+static void test_unit_vector(uint32_t bits, TestRng &rng) {
+  std::vector<Point3> dirs;
+  for (int axis = 0; axis < 3; ++axis)
+    for (float s : {1.f, -1.f}) {
+      Point3 p(0, 0, 0);
+      p[axis] = s;
+      dirs.push_back(p);
+      p[(axis + 1) % 3] = 1e-6f * s; // next to axis, across octahedron fold
+      dirs.push_back(normalize(p));
+    }
+  for (float x : {1.f, -1.f})
+    for (float y : {1.f, -1.f})
+      for (float z : {1.f, -1.f})
+        dirs.push_back(normalize(Point3(x, y, z)));
+  while (dirs.size() < 100000)
+    dirs.push_back(random_dir(rng));
+
+  double maxErr = 0, bound = max_unit_vector_error_deg(bits);
+  for (const Point3 &d : dirs) {
+    Point3 r;
+    TEST_CHECK(round_trip(danet::unit_vector(d, bits), danet::unit_vector(r, bits)), "unit vector %u bits: read failed", bits);
+    TEST_CHECK(fabsf(length(r) - 1) < 1e-5f, "unit vector %u bits: result is not normalized", bits);
+    double err = angle_deg(d, r);
+    maxErr = err > maxErr ? err : maxErr;
+    TEST_CHECK(err <= bound, "unit vector %u bits: (%g %g %g) error %g deg, bound %g", bits, d.x, d.y, d.z, err, bound);
+    Point3 scaled;
+    round_trip(danet::unit_vector(d * 37.f, bits), danet::unit_vector(scaled, bits)); // input need not be normalized
+    TEST_CHECK(angle_deg(d, scaled) <= bound, "unit vector %u bits: scaled input error %g deg", bits, angle_deg(d, scaled));
+  }
+  Point3 zero;
+  round_trip(danet::unit_vector(Point3(0, 0, 0), bits), danet::unit_vector(zero, bits));
+  TEST_CHECK(angle_deg(zero, Point3(0, 0, 1)) <= bound, "unit vector %u bits: zero vector is not read as +Z", bits);
+  fprintf(stderr, "unit vector %2u bits: max error %.4f deg, bound %.4f\n", bits, maxErr, bound);
+}
+
+static void test_quat(uint32_t bits, TestRng &rng) {
+  const float H = float(M_SQRT1_2);
+  std::vector<Quat> quats = {Quat(0, 0, 0, 1), Quat(1, 0, 0, 0), Quat(0, 1, 0, 0), Quat(0, 0, 1, 0), // identity, 180 degrees
+    Quat(H, 0, 0, H), Quat(0, H, 0, -H), Quat(0, 0, -H, H),                                          // two largest equal
+    Quat(0.5f, 0.5f, 0.5f, 0.5f), Quat(-0.5f, 0.5f, -0.5f, 0.5f)};                                 // all equal
+  while (quats.size() < 100000)
+    quats.push_back(random_quat(rng));
+
+  double maxErr = 0, bound = max_quat_error_deg(bits);
+  for (const Quat &q : quats) {
+    Quat rq;
+    for (float s : {1.f, -1.f}) { // q and -q are same rotation and must give same result
+      Quat in(q.x * s, q.y * s, q.z * s, q.w * s), r;
+      TEST_CHECK(round_trip(danet::quat_smallest3(in, bits), danet::quat_smallest3(r, bits)), "quat %u bits: read failed", bits);
+      if (s > 0)
+        rq = r;
+      else
+        TEST_CHECK(r.x == rq.x && r.y == rq.y && r.z == rq.z && r.w == rq.w, "quat %u bits: q and -q read differently", bits);
+      double err = rotation_error_deg(q, r);
+      maxErr = err > maxErr ? err : maxErr;
+      TEST_CHECK(err <= bound, "quat %u bits: (%g %g %g %g) error %g deg, bound %g", bits, in.x, in.y, in.z, in.w, err, bound);
+      Quat scaled(in.x * 3, in.y * 3, in.z * 3, in.w * 3); // input need not be normalized
+      round_trip(danet::quat_smallest3(scaled, bits), danet::quat_smallest3(r, bits));
+      TEST_CHECK(rotation_error_deg(q, r) <= bound, "quat %u bits: scaled input error %g deg", bits, rotation_error_deg(q, r));
+    }
+  }
+  fprintf(stderr, "quat        %2u bits: max error %.4f deg, bound %.4f\n", bits, maxErr, bound);
+}
+
+static void test_pos(uint32_t bits, TestRng &rng) {
+  BBox3 box(Point3(-1000.f, -3.5f, 20.f), Point3(1000.f, 96.5f, 70.f));
+  Point3 size = box.width();
+  std::vector<Point3> points = {box.lim[0], box.lim[1], box.center(), Point3(box.lim[0].x, box.lim[1].y, box.lim[0].z)};
+  while (points.size() < 100000)
+    points.push_back(Point3(rng.uniform(box.lim[0].x, box.lim[1].x), rng.uniform(box.lim[0].y, box.lim[1].y),
+      rng.uniform(box.lim[0].z, box.lim[1].z)));
+
+  double maxRel = 0;
+  for (const Point3 &p : points) {
+    Point3 r;
+    TEST_CHECK(round_trip(danet::quantized_pos(p, box, bits), danet::quantized_pos(r, box, bits)), "pos %u bits: read failed", bits);
+    for (int i = 0; i < 3; ++i) {
+      double rounding = 1e-6 * (fabs(box.lim[0][i]) + fabs(box.lim[1][i])); // result is float
+      double bound = max_pos_error(size[i], bits) + rounding, err = fabs(double(r[i]) - p[i]);
+      maxRel = err / max_pos_error(size[i], bits) > maxRel ? err / max_pos_error(size[i], bits) : maxRel;
+      TEST_CHECK(err <= bound, "pos %u bits: axis %d of (%g %g %g) error %g, bound %g", bits, i, p.x, p.y, p.z, err, bound);
+    }
+  }
+  for (const Point3 &limit : {box.lim[0], box.lim[1]}) { // positions at range limits are exact, ones outside are clamped
+    Point3 r, outside = limit + (limit - box.center()) * 0.5f;
+    round_trip(danet::quantized_pos(limit, box, bits), danet::quantized_pos(r, box, bits));
+    TEST_CHECK(r == limit, "pos %u bits: box limit (%g %g %g) read as (%g %g %g)", bits, limit.x, limit.y, limit.z, r.x, r.y, r.z);
+    round_trip(danet::quantized_pos(outside, box, bits), danet::quantized_pos(r, box, bits));
+    TEST_CHECK(r == limit, "pos %u bits: outside point is not clamped to (%g %g %g)", bits, limit.x, limit.y, limit.z);
+  }
+  fprintf(stderr, "pos         %2u bits: max error %.4f of bound\n", bits, maxRel);
+}
+
+static void test_tm(uint32_t rot_bits, uint32_t pos_bits, TestRng &rng) {
+  BBox3 box(Point3(-500.f, -50.f, -500.f), Point3(500.f, 200.f, 500.f));
+  double rotBound = max_quat_error_deg(rot_bits) / RAD_TO_DEG; // max move of unit column, radians
+  const double HALF_REL_ERROR = 0.0005;
+  for (int i = 0; i < 20000; ++i) {
+    TMatrix tm = makeTM(random_quat(rng));
+    Point3 scale(1, 1, 1);
+    if (i % 4 == 1)
+      scale = Point3(rng.uniform(0.1f, 10.f), rng.uniform(0.1f, 10.f), rng.uniform(0.1f, 10.f));
+    else if (i % 4 == 2)
+      scale = Point3(-rng.uniform(0.5f, 2.f), 1, 1); // mirroring
+    for (int c = 0; c < 3; ++c)
+      tm.setcol(c, tm.getcol(c) * scale[c]);
+    tm.setcol(3, i % 50 ? Point3(rng.uniform(box.lim[0].x, box.lim[1].x), rng.uniform(box.lim[0].y, box.lim[1].y),
+                                   rng.uniform(box.lim[0].z, box.lim[1].z))
+                        : box.lim[i % 100 ? 1 : 0]);
+
+    TMatrix r;
+    TEST_CHECK(round_trip(danet::compressed_tm(tm, box, rot_bits, pos_bits), danet::compressed_tm(r, box, rot_bits, pos_bits)),
+      "tm %u/%u bits: read failed", rot_bits, pos_bits);
+    for (int c = 0; c < 3; ++c) {
+      double s = fabs(scale[c]), err = length(r.getcol(c) - tm.getcol(c)), bound = s * (rotBound + HALF_REL_ERROR) + 1e-5 * s;
+      TEST_CHECK(err <= bound, "tm %u/%u bits: column %d error %g, bound %g (scale %g)", rot_bits, pos_bits, c, err, bound, s);
+    }
+    for (int a = 0; a < 3; ++a) {
+      double err = fabs(double(r.getcol(3)[a]) - tm.getcol(3)[a]), bound = max_pos_error(box.width()[a], pos_bits) + 1e-4;
+      TEST_CHECK(err <= bound, "tm %u/%u bits: position axis %d error %g, bound %g", rot_bits, pos_bits, a, err, bound);
+    }
+    TEST_CHECK((r.det() < 0) == (tm.det() < 0), "tm %u/%u bits: mirroring lost", rot_bits, pos_bits);
+  }
+}
+
+// SegmentedBitStream shares value mappings with BitStream, so same writes give same bytes across chunk boundaries
+template <typename S>
+static void write_mixed(S &bs, TestRng &rng, const BBox3 &box) {
+  for (int i = 0; i < 300; ++i) {
+    bs.Write(danet::unit_vector(random_dir(rng)));
+    bs.Write(danet::quat_smallest3(random_quat(rng), 8 + i % 9));
+    bs.Write(danet::quantized_pos(Point3(rng.uniform(-600, 600), 0, rng.uniform(-600, 600)), box, 1 + i % 32));
+    bs.Write(danet::compressed_tm(makeTM(random_quat(rng)) * (i % 3 ? 1.f : 2.5f), box));
+    bs.WriteRanged(int(rng.next32() % 300) - 150, -100, 100);
+    bs.WriteQuantized(rng.uniform(-2, 2), -1.f, 1.f, 1 + i % 32);
+    bs.WriteCompressed(uint64_t(rng.next() >> (i % 64)));
+    bs.WriteCompressed(int32_t(rng.next32()) >> (i % 32));
+  }
+}
+
+static void test_segmented(TestRng &rng) {
+  BBox3 box(Point3(-500.f, -50.f, -500.f), Point3(500.f, 200.f, 500.f));
+  TestRng rngCopy = rng;
+  danet::BitStream bs;
+  write_mixed(bs, rng, box);
+  danet::BitStreamChunkPool pool(64);
+  danet::SegmentedBitStream seg(pool);
+  write_mixed(seg, rngCopy, box);
+  dag::ConstSpan<uint8_t> data = seg.Linearize();
+  TEST_CHECK(seg.GetNumberOfBitsUsed() == bs.GetNumberOfBitsUsed(), "segmented: %u bits written, %u by BitStream",
+    seg.GetNumberOfBitsUsed(), bs.GetNumberOfBitsUsed());
+  TEST_CHECK(data.size() == bs.GetNumberOfBytesUsed() && !memcmp(data.data(), bs.GetData(), data.size()),
+    "segmented: bytes differ from BitStream ones");
+}
+
+int main() {
+  dagor_force_init_memmgr();
+  TestRng rng(42);
+  for (uint32_t bits : {8, 10, 12, 16})
+    test_unit_vector(bits, rng);
+  for (uint32_t bits : {8, 10, 12, 16})
+    test_quat(bits, rng);
+  for (uint32_t bits : {8, 12, 16, 20})
+    test_pos(bits, rng);
+  test_tm(10, 16, rng);
+  test_tm(12, 20, rng);
+  test_tm(8, 12, rng);
+  test_segmented(rng);
+  return test_result("bitstreamMath");
+}
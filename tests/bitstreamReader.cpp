@@ -0,0 +1,223 @@
+#include "test.h"
+#include <bitstream/bitstreamReader.h>
+#include <bitstream/bitstreamMath.h>
+#include <memory/dag_mem.h>
+#include <string.h>
+#include <vector>
+
+void (*dgs_fatal_report)(const char *, const char *) = nullptr;
+
+// Readers must not read past stream when caller skips the check: after failure every read gives zeros.
+
+struct Fields {
+  uint32_t id;
+  bool alive;
+  float pos[3];
+  uint64_t bits40;
+  int ranged;
+};
+
+static const uint32_t FIELD_BITS = 32 + 1 + 3 * 32 + 40 + 7;
+
+static void write_fields(danet::BitStream &bs, const Fields &f) {
+  bs.Write(f.id);
+  bs.Write(f.alive);
+  bs.Write(f.pos);
+  bs.WriteBitsValue(f.bits40, 40);
+  bs.WriteRanged(f.ranged, -50, 50);
+}
+
+template <typename Reader>
+static Fields read_fields(Reader &r) {
+  Fields f;
+  memset(&f, 0xAB, sizeof(f));
+  r.Read(f.id);
+  r.Read(f.alive);
+  r.Read(f.pos);
+  r.ReadBitsValue(f.bits40, 40);
+  r.ReadRanged(f.ranged, -50, 50);
+  return f;
+}
+
+static bool is_zero(const Fields &f) {
+  return !f.id && !f.alive && !f.pos[0] && !f.pos[1] && !f.pos[2] && !f.bits40 && f.ranged == -50;
+}
+
+static bool same(const Fields &a, const Fields &b) {
+  return a.id == b.id && a.alive == b.alive && !memcmp(a.pos, b.pos, sizeof(a.pos)) && a.bits40 == b.bits40 &&
+         a.ranged == b.ranged;
+}
+
+static Fields random_fields(TestRng &rng) {
+  Fields f;
+  f.id = rng.next32();
+  f.alive = rng.next32() & 1;
+  for (float &p : f.pos)
+    p = rng.uniform(-4096.f, 4096.f);
+  f.bits40 = rng.next() >> 24;
+  f.ranged = int(rng.next32() % 101) - 50;
+  return f;
+}
+
+// stream is copied to buffer of exact size, so any read past it is out of bounds (caught by sanitizers)
+static void check_truncated(const Fields &src, uint32_t tail_bits, uint32_t len, uint32_t skip_bits) {
+  danet::BitStream w;
+  write_fields(w, src);
+  w.WriteBitsValue(0, tail_bits);
+  len = len < w.GetNumberOfBytesUsed() ? len : w.GetNumberOfBytesUsed();
+  std::vector<uint8_t> buf(w.GetData(), w.GetData() + len);
+  danet::BitStream bs(buf.data(), len, false);
+  bs.IgnoreBits(skip_bits);
+  bool fits = bs.GetNumberOfUnreadBits() >= FIELD_BITS;
+
+  danet::ValidatedReader v(bs, FIELD_BITS); // result deliberately not checked before reads
+  Fields f = read_fields(v);
+  TEST_CHECK(v.IsOk() == fits, "validated: len %u skip %u: ok %d, expected %d", len, skip_bits, v.IsOk(), fits);
+  if (!fits)
+    TEST_CHECK(is_zero(f), "validated: len %u skip %u: failed reader gave non-zero fields", len, skip_bits);
+  else if (!skip_bits)
+    TEST_CHECK(same(f, src), "validated: len %u: fields differ", len);
+#if DAGOR_DBGLEVEL < 1 // asserted in debug build
+  // past declared layout: failed reader gives zeros, otherwise read is unchecked (so only done inside stream)
+  if (!fits || len * 8 >= skip_bits + FIELD_BITS + 8) {
+    uint32_t extra = 0;
+    v.ReadBitsValue(extra, 8);
+    TEST_CHECK(!v.IsOk(), "validated: len %u skip %u: read past declared layout did not fail", len, skip_bits);
+    TEST_CHECK(fits || !extra, "validated: len %u skip %u: failed reader gave non-zero value", len, skip_bits);
+  }
+#endif
+
+  bs.ResetReadPointer();
+  bs.IgnoreBits(skip_bits);
+  danet::StickyReader s(bs);
+  f = read_fields(s);
+  TEST_CHECK(s.IsOk() == fits, "sticky: len %u skip %u: ok %d, expected %d", len, skip_bits, s.IsOk(), fits);
+  if (!fits)
+    TEST_CHECK(bs.GetReadOffset() == bs.GetNumberOfBitsUsed(), "sticky: failed reader left read offset in stream");
+}
+
+// wrappers of bitstreamMath.h can't be value-initialized, failed reads zero referenced values with reset_type()
+struct MathFields {
+  Point3 n, pos;
+  Quat q;
+  TMatrix tm;
+};
+
+static const BBox3 MATH_BOX(Point3(-100, -100, -100), Point3(100, 100, 100));
+
+template <typename Reader>
+static MathFields read_math_fields(Reader &r) {
+  MathFields f;
+  f.n = f.pos = Point3(7, 7, 7);
+  f.q = Quat(3, 3, 3, 3);
+  f.tm.identity();
+  r.Read(danet::unit_vector(f.n));
+  r.Read(danet::quat_smallest3(f.q));
+  r.Read(danet::quantized_pos(f.pos, MATH_BOX));
+  r.Read(danet::compressed_tm(f.tm, MATH_BOX));
+  return f;
+}
+
+// which fields are zero, bit per field in read order
+static uint32_t zero_mask(const MathFields &f) {
+  bool tmZero = true;
+  for (int i = 0; i < 4; ++i)
+    tmZero = tmZero && f.tm.getcol(i) == Point3(0, 0, 0);
+  bool qZero = f.q.x == 0 && f.q.y == 0 && f.q.z == 0 && f.q.w == 0;
+  return (f.n == Point3(0, 0, 0) ? 1 : 0) | (qZero ? 2 : 0) | (f.pos == Point3(0, 0, 0) ? 4 : 0) | (tmZero ? 8 : 0);
+}
+
+static void check_math_truncated() {
+  danet::BitStream w;
+  TMatrix tm = TMatrix::IDENT;
+  tm.setcol(3, Point3(1, 2, 3));
+  uint32_t fieldEnd[4];
+  w.Write(danet::unit_vector(Point3(0, 1, 0)));
+  fieldEnd[0] = w.GetNumberOfBitsUsed();
+  w.Write(danet::quat_smallest3(Quat(0, 0, 0, 1)));
+  fieldEnd[1] = w.GetNumberOfBitsUsed();
+  w.Write(danet::quantized_pos(Point3(1, 2, 3), MATH_BOX));
+  fieldEnd[2] = w.GetNumberOfBitsUsed();
+  w.Write(danet::compressed_tm(tm, MATH_BOX));
+  fieldEnd[3] = w.GetNumberOfBitsUsed();
+  for (uint32_t len = 0; len <= w.GetNumberOfBytesUsed(); ++len) {
+    std::vector<uint8_t> buf(w.GetData(), w.GetData() + len);
+    danet::BitStream bs(buf.data(), len, false);
+    uint32_t failedMask = 0;
+    for (int i = 0; i < 4; ++i)
+      if (fieldEnd[i] > len * 8)
+        failedMask |= 1 << i;
+
+    danet::StickyReader s(bs);
+    uint32_t zeros = zero_mask(read_math_fields(s));
+    TEST_CHECK(s.IsOk() == !failedMask, "math sticky: len %u: ok %d", len, s.IsOk());
+    TEST_CHECK(zeros == failedMask, "math sticky: len %u: zero fields %x, failed %x", len, zeros, failedMask);
+
+    // whole stream is declared, so reads fail even if they fit in stream
+    bs.ResetReadPointer();
+    danet::ValidatedReader v(bs, len * 8);
+    zeros = zero_mask(read_math_fields(v));
+    TEST_CHECK(!v.IsOk() && zeros == 15, "math validated: len %u: ok %d, zero fields %x", len, v.IsOk(), zeros);
+  }
+}
+
+int main() {
+  dagor_force_init_memmgr();
+
+  // reported case: stream already consumed, fixed fields read right after constructor
+  {
+    Fields src = {1, true, {1.f, 2.f, 3.f}, 5, 7};
+    danet::BitStream w;
+    write_fields(w, src);
+    std::vector<uint8_t> buf(w.GetData(), w.GetData() + w.GetNumberOfBytesUsed());
+    danet::BitStream bs(buf.data(), uint32_t(buf.size()), false);
+    uint32_t id = 0;
+    TEST_CHECK(bs.Read(id) && id == src.id, "reading first field failed");
+    bs.IgnoreBits(bs.GetNumberOfUnreadBits());
+    danet::ValidatedReader r(bs, FIELD_BITS);
+    TEST_CHECK(!r, "reader over consumed stream is ok");
+    TEST_CHECK(is_zero(read_fields(r)), "reader over consumed stream gave non-zero fields");
+  }
+
+  // failed later Require() drops fields declared before it
+  {
+    danet::BitStream w;
+    w.Write(uint32_t(42));
+    danet::ValidatedReader r(w, 32);
+    TEST_CHECK(!r.Require(1) && !r, "Require() past stream end succeeded");
+    uint32_t v = 1;
+    r.Read(v);
+    TEST_CHECK(!v, "field declared before failed Require() was read: %u", v);
+  }
+
+  // caller ignores failed Require() of size taken from stream and reads all it asked for
+  {
+    danet::BitStream w;
+    w.Write(uint32_t(100000));
+    std::vector<uint8_t> buf(w.GetData(), w.GetData() + w.GetNumberOfBytesUsed());
+    danet::BitStream bs(buf.data(), uint32_t(buf.size()), false);
+    danet::ValidatedReader r(bs, 32);
+    uint32_t count = 0;
+    r.Read(count);
+    r.Require(count * 64);
+    uint64_t any = 0;
+    for (uint32_t i = 0; i < count; ++i) {
+      uint64_t v = 1;
+      r.Read(v);
+      any |= v;
+    }
+    TEST_CHECK(!r && !any, "reads after failed Require(): ok %d, non-zero %d", r.IsOk(), any != 0);
+    TEST_CHECK(bs.GetReadOffset() == bs.GetNumberOfBitsUsed(), "failed reader left read offset in stream");
+  }
+
+  check_math_truncated();
+
+  TestRng rng(48);
+  for (int i = 0; i < 20000; ++i) {
+    Fields src = random_fields(rng);
+    uint32_t fullBytes = (FIELD_BITS + 7) / 8 + 2;
+    check_truncated(src, rng.next32() % 17, rng.next32() % (fullBytes + 1), rng.next32() % 4 == 0 ? rng.next32() % 24 : 0);
+  }
+
+  return test_result("bitstreamReader");
+}
@@ -0,0 +1,105 @@
+#include "test.h"
+#include <datablock/datablock.h>
+#include <ioSys/dag_memIo.h>
+#include <memory/dag_mem.h>
+#include <stdio.h>
+#include <functional>
+#include <string>
+
+void (*dgs_fatal_report)(const char *, const char *) = nullptr;
+
+// Relocated tree behaves as regular one: same mutations give same contents and hashes, relocating again
+// and destroying partially detached tree are fine (leaks and double frees are caught by sanitizers).
+
+static std::string to_text(const DataBlock &blk) {
+  DynamicMemGeneralSaveCB cb(tmpmem);
+  blk.saveToTextStream(cb);
+  return std::string((const char *)cb.data(), cb.size());
+}
+
+static void fill(DataBlock &blk, int depth, int &counter) {
+  char buf[64];
+  for (int i = 0; i < 4; ++i) {
+    blk.addInt("i", counter++);
+    snprintf(buf, sizeof(buf), "string value %d", counter++);
+    blk.addStr("s", buf);
+  }
+  if (depth < 3)
+    for (int i = 0; i < 3; ++i)
+      fill(*blk.addNewBlock(i == 1 ? "other" : "sub"), depth + 1, counter);
+}
+
+static DataBlock *deep_block(DataBlock &root) {
+  return root.getBlockByName("sub")->getBlockByName("other")->getBlockByName("sub");
+}
+
+static void check_same(const char *what, DataBlock &relocated, DataBlock &plain) {
+  TEST_CHECK(to_text(relocated) == to_text(plain), "%s: contents differ from regular tree", what);
+  TEST_CHECK(relocated.getContentHash() == plain.getContentHash(), "%s: content hashes differ", what);
+}
+
+int main() {
+  dagor_force_init_memmgr();
+
+  DataBlock src;
+  int counter = 0;
+  fill(src, 0, counter);
+  std::string text = to_text(src);
+  const char *fname = "datablockArena.test.blk";
+  FILE *fp = fopen(fname, "wb");
+  TEST_CHECK(fp && fwrite(text.data(), 1, text.size(), fp) == text.size(), "can't write %s", fname);
+  if (fp)
+    fclose(fp);
+
+  {
+    DataBlock relocated, plain;
+    TEST_CHECK(relocated.load(fname, DataBlock::SHRINK_RELOCATE), "SHRINK_RELOCATE load failed");
+    TEST_CHECK(plain.load(fname), "regular load failed");
+    check_same("loaded", relocated, plain);
+    TEST_CHECK(!deep_block(relocated)->relocate(), "sub-block was relocated");
+    TEST_CHECK(relocated.relocate(), "relocating again failed");
+    check_same("relocated twice", relocated, plain);
+
+    DataBlock *keptSub = relocated.getBlockByName("other");
+    std::function<void(DataBlock &)> mutations[] = {
+      [](DataBlock &b) { b.setInt("i", -1); },
+      [](DataBlock &b) { deep_block(b)->setStr("s", "replaced string, longer than one it replaces"); },
+      [](DataBlock &b) { deep_block(b)->addStr("added", "new string"); },
+      [](DataBlock &b) { deep_block(b)->addNewBlock("added")->addStr("s", "in new block"); },
+      [](DataBlock &b) { b.getBlockByName("other")->removeParam("s"); },
+      [](DataBlock &b) { b.getBlockByName("sub")->removeBlock("other"); },
+      [](DataBlock &b) { b.getBlockByName("other")->getBlockByName("sub")->addInt("i", 7); },
+    };
+    int step = 0;
+    for (auto &mutate : mutations) {
+      mutate(relocated);
+      mutate(plain);
+      char what[32];
+      snprintf(what, sizeof(what), "mutation %d", step++);
+      check_same(what, relocated, plain);
+      TEST_CHECK(relocated.getBlockByName("other") == keptSub, "%s: sub-block object moved", what);
+    }
+
+    // partially detached tree: modified blocks are in heap, others in arena
+    TEST_CHECK(relocated.relocate(), "relocating modified tree failed");
+    check_same("relocated after mutations", relocated, plain);
+    for (DataBlock *b : {&relocated, &plain})
+      b->getBlockByName("other")->getBlockByName("sub")->setStr("s", "after second relocation");
+    relocated.removeBlock("other");
+    plain.removeBlock("other");
+    check_same("mutated after second relocation", relocated, plain);
+  }
+
+  {
+    // tree destroyed right after load, and after detaching some of its blocks only
+    DataBlock relocated;
+    relocated.load(fname, DataBlock::SHRINK_RELOCATE);
+    DataBlock partial;
+    partial.load(fname, DataBlock::SHRINK_RELOCATE);
+    deep_block(partial)->addStr("s", "detached");
+    partial.getBlockByName("other")->removeBlock("sub");
+  }
+
+  remove(fname);
+  return test_result("datablockArena");
+}
@@ -0,0 +1,126 @@
+#include "test.h"
+#include <datablock/datablock.h>
+#include <ioSys/dag_memIo.h>
+#include <memory/dag_mem.h>
+#include <float.h>
+#include <math.h>
+#include <string.h>
+#include <vector>
+
+void (*dgs_fatal_report)(const char *, const char *) = nullptr;
+
+// Reals saved with SAVE_TEXT_EXACT_REALS must load back with identical bits, for any finite value.
+
+static uint32_t bits_of(float f) {
+  uint32_t u;
+  memcpy(&u, &f, sizeof(u));
+  return u;
+}
+
+static float from_bits(uint32_t u) {
+  float f;
+  memcpy(&f, &u, sizeof(f));
+  return f;
+}
+
+// random finite bit patterns, with denormals and exponent extremes drawn more often than uniform bits would give
+static float random_finite(TestRng &rng) {
+  uint32_t u = rng.next32();
+  switch (rng.next32() % 8) {
+    case 0: u &= 0x807FFFFFu; break; // denormal or zero
+    case 1: u = (u & 0x807FFFFFu) | (rng.next32() % 2 ? 0x00800000u : 0x7F000000u); break; // extreme exponents
+    case 2: u &= 0x80000007u; break; // smallest denormals
+    default: break;
+  }
+  if ((u & 0x7F800000u) == 0x7F800000u) // Inf/NaN have no exact text form
+    u &= ~0x00800000u;
+  return from_bits(u);
+}
+
+static std::vector<float> make_values(int n) {
+  std::vector<float> v = {0.f, -0.f, FLT_MIN, -FLT_MIN, FLT_MAX, -FLT_MAX, FLT_TRUE_MIN, -FLT_TRUE_MIN, 1.f, -1.f, 0.1f,
+    1.f / 3.f, 16777216.f, 16777217.f, nextafterf(1.f, 2.f), nextafterf(FLT_MIN, 0.f)};
+  TestRng rng(27);
+  while (int(v.size()) < n)
+    v.push_back(random_finite(rng));
+  return v;
+}
+
+static void fill_block(DataBlock &blk, const std::vector<float> &v, size_t &at) {
+  auto next = [&] { return v[at++ % v.size()]; };
+  for (int i = 0; i < 256; ++i)
+    blk.addReal("r", next());
+  for (int i = 0; i < 32; ++i) {
+    Point2 p2(next(), next());
+    blk.addPoint2("p2", p2);
+    Point3 p3(next(), next(), next());
+    blk.addPoint3("p3", p3);
+    Point4 p4(next(), next(), next(), next());
+    blk.addPoint4("p4", p4);
+    TMatrix tm;
+    for (int r = 0; r < 4; ++r)
+      for (int c = 0; c < 3; ++c)
+        tm.m[r][c] = next();
+    blk.addTm("tm", tm);
+  }
+}
+
+static void check_same(const DataBlock &a, const DataBlock &b, int blk_no) {
+  TEST_CHECK(a.paramCount() == b.paramCount(), "block %d: %d params saved, %d loaded", blk_no, a.paramCount(), b.paramCount());
+  auto same = [&](const float *x, const float *y, int n, int param) {
+    for (int i = 0; i < n; ++i)
+      TEST_CHECK(bits_of(x[i]) == bits_of(y[i]), "block %d param %d[%d]: saved %08x (%.9g), loaded %08x (%.9g)", blk_no, param,
+        i, bits_of(x[i]), x[i], bits_of(y[i]), y[i]);
+  };
+  for (int i = 0; i < a.paramCount() && i < b.paramCount(); ++i) {
+    TEST_CHECK(a.getParamType(i) == b.getParamType(i), "block %d param %d: type changed", blk_no, i);
+    switch (a.getParamType(i)) {
+      case DataBlock::TYPE_REAL: {
+        float x = a.getReal(i), y = b.getReal(i);
+        same(&x, &y, 1, i);
+        break;
+      }
+      case DataBlock::TYPE_POINT2: {
+        Point2 x = a.getPoint2(i), y = b.getPoint2(i);
+        same(&x.x, &y.x, 2, i);
+        break;
+      }
+      case DataBlock::TYPE_POINT3: {
+        Point3 x = a.getPoint3(i), y = b.getPoint3(i);
+        same(&x.x, &y.x, 3, i);
+        break;
+      }
+      case DataBlock::TYPE_POINT4: {
+        Point4 x = a.getPoint4(i), y = b.getPoint4(i);
+        same(&x.x, &y.x, 4, i);
+        break;
+      }
+      case DataBlock::TYPE_MATRIX: {
+        TMatrix x = a.getTm(i), y = b.getTm(i);
+        same(&x.m[0][0], &y.m[0][0], 12, i);
+        break;
+      }
+      default: break;
+    }
+  }
+}
+
+int main() {
+  dagor_force_init_memmgr();
+
+  std::vector<float> values = make_values(200000);
+  DataBlock src;
+  size_t at = 0;
+  while (at < values.size())
+    fill_block(*src.addNewBlock("values"), values, at);
+
+  DynamicMemGeneralSaveCB cb(tmpmem);
+  src.saveToTextStream(cb, DataBlock::SAVE_TEXT_EXACT_REALS);
+  DataBlock loaded;
+  TEST_CHECK(loaded.loadText(cb.data(), cb.size()), "saved text failed to load");
+  TEST_CHECK(loaded.blockCount() == src.blockCount(), "%d blocks saved, %d loaded", src.blockCount(), loaded.blockCount());
+  for (int i = 0; i < src.blockCount() && i < loaded.blockCount(); ++i)
+    check_same(*src.getBlock(i), *loaded.getBlock(i), i);
+
+  return test_result("datablockExactReals");
+}
@@ -0,0 +1,134 @@
+#include "test.h"
+#include <datablock/datablock.h>
+#include <ioSys/dag_memIo.h>
+#include <memory/dag_mem.h>
+#include <string.h>
+#include <string>
+
+void (*dgs_fatal_report)(const char *, const char *) = nullptr;
+
+// mergeFrom() gives the same tree as the one written by hand, for every mode and for marker params.
+// Each tree is loaded separately, so override tree always has its own NameMap with different name ids.
+
+static std::string to_text(const DataBlock &blk) {
+  DynamicMemGeneralSaveCB cb(tmpmem);
+  blk.saveToTextStream(cb);
+  return std::string((const char *)cb.data(), cb.size());
+}
+
+static void load(DataBlock &blk, const char *text) {
+  std::string copy(text);
+  TEST_CHECK(blk.loadText(copy.data(), int(copy.size())), "can't parse: %s", text);
+}
+
+static const char *BASE = "a:i=1; a:i=2; s:t=\"base\";\n"
+                          "x{ p:i=1; q:i=2; deep{ v:i=1; } }\n"
+                          "x{ p:i=3; }\n"
+                          "z{ k:i=1; }\n";
+
+static void check_merge(const char *what, const char *over_text, int flags, const char *expected_text) {
+  DataBlock base, over, expected;
+  load(base, BASE);
+  load(over, over_text);
+  load(expected, expected_text);
+  base.getContentHash(); // cached hashes of modified blocks must be dropped
+  base.mergeFrom(over, flags);
+  TEST_CHECK(to_text(base) == to_text(expected), "%s: merged tree differs:\n%s\nexpected:\n%s", what, to_text(base).c_str(),
+    to_text(expected).c_str());
+  TEST_CHECK(base.getContentHash() == expected.getContentHash(), "%s: content hash differs", what);
+}
+
+int main() {
+  dagor_force_init_memmgr();
+
+  // pairing by name and occurrence, unpaired items appended; names of override tree are new to base
+  check_merge("default",
+    "a:i=5; s:r=1.5; n:b=yes;\n"
+    "x{ p:i=9; deep{ w:t=\"new\"; } }\n"
+    "x{ r:i=4; }\n"
+    "x{ e:i=1; }\n"
+    "y{ u:i=1; y{ u:i=2; } }\n",
+    0,
+    "a:i=5; a:i=2; s:r=1.5; n:b=yes;\n"
+    "x{ p:i=9; q:i=2; deep{ v:i=1; w:t=\"new\"; } }\n"
+    "x{ p:i=3; r:i=4; }\n"
+    "z{ k:i=1; }\n"
+    "x{ e:i=1; }\n"
+    "y{ u:i=1; y{ u:i=2; } }\n");
+
+  check_merge("append params", "a:i=5; s:t=\"over\";\nx{ p:i=9; }\n", DataBlock::MERGE_APPEND_PARAMS,
+    "a:i=1; a:i=2; s:t=\"base\"; a:i=5; s:t=\"over\";\n"
+    "x{ p:i=1; q:i=2; p:i=9; deep{ v:i=1; } }\n"
+    "x{ p:i=3; }\n"
+    "z{ k:i=1; }\n");
+
+  check_merge("append blocks", "a:i=5;\nx{ p:i=9; }\nz{ k:i=2; }\n", DataBlock::MERGE_APPEND_BLOCKS,
+    "a:i=5; a:i=2; s:t=\"base\";\n"
+    "x{ p:i=1; q:i=2; deep{ v:i=1; } }\n"
+    "x{ p:i=3; }\n"
+    "z{ k:i=1; }\n"
+    "x{ p:i=9; }\n"
+    "z{ k:i=2; }\n");
+
+  check_merge("append both", "a:i=5;\nx{ p:i=9; }\n", DataBlock::MERGE_APPEND_PARAMS | DataBlock::MERGE_APPEND_BLOCKS,
+    "a:i=1; a:i=2; s:t=\"base\"; a:i=5;\n"
+    "x{ p:i=1; q:i=2; deep{ v:i=1; } }\n"
+    "x{ p:i=3; }\n"
+    "z{ k:i=1; }\n"
+    "x{ p:i=9; }\n");
+
+  check_merge("replace blocks", "x{ p:i=9; }\nx{}\nw{ k:i=3; }\n", DataBlock::MERGE_REPLACE_BLOCKS,
+    "a:i=1; a:i=2; s:t=\"base\";\n"
+    "x{ p:i=9; }\n"
+    "x{}\n"
+    "z{ k:i=1; }\n"
+    "w{ k:i=3; }\n");
+
+  // deleted names go away before merging of the same block, so re-added ones are appended; unknown names are ignored
+  check_merge("delete",
+    "__delete:t=\"a\"; __delete:t=\"z\"; __delete:t=\"unknown\"; a:i=7;\n"
+    "x{ __delete:t=\"deep\"; __delete:t=\"q\"; }\n"
+    "x{ __delete:t=\"p\"; }\n",
+    0,
+    "s:t=\"base\"; a:i=7;\n"
+    "x{ p:i=1; }\n"
+    "x{}\n");
+
+  check_merge("override",
+    "x{ __override:b=yes; r:i=4; sub{ v:i=1; } }\n"
+    "x{ __override:b=no; p:i=5; }\n"
+    "z{ __override:b=yes; }\n",
+    0,
+    "a:i=1; a:i=2; s:t=\"base\";\n"
+    "x{ r:i=4; sub{ v:i=1; } }\n"
+    "x{ p:i=5; }\n"
+    "z{}\n");
+
+  // markers in sub-blocks copied as a whole are dropped too
+  check_merge("markers in added block", "y{ __delete:t=\"u\"; __override:b=yes; u:i=1; }\n", 0,
+    "a:i=1; a:i=2; s:t=\"base\";\n"
+    "x{ p:i=1; q:i=2; deep{ v:i=1; } }\n"
+    "x{ p:i=3; }\n"
+    "z{ k:i=1; }\n"
+    "y{ u:i=1; }\n");
+
+  check_merge("ignore markers", "__delete:t=\"a\";\nz{ __override:b=yes; }\n", DataBlock::MERGE_IGNORE_MARKERS,
+    "a:i=1; a:i=2; s:t=\"base\"; __delete:t=\"a\";\n"
+    "x{ p:i=1; q:i=2; deep{ v:i=1; } }\n"
+    "x{ p:i=3; }\n"
+    "z{ k:i=1; __override:b=yes; }\n");
+
+  // override tree is left intact and its blocks are not shared with result
+  {
+    DataBlock base, over;
+    load(base, BASE);
+    load(over, "x{ p:i=9; }\ny{ u:i=1; }\n");
+    std::string overText = to_text(over);
+    base.mergeFrom(over);
+    base.getBlockByName("y")->setInt("u", 2);
+    over.mergeFrom(over);
+    TEST_CHECK(to_text(over) == overText, "override tree was modified");
+  }
+
+  return test_result("datablockMerge");
+}
@@ -0,0 +1,119 @@
+#include "test.h"
+#include <datablock/datablock.h>
+#include <bitstream/bitstream.h>
+#include <ioSys/dag_memIo.h>
+#include <memory/dag_mem.h>
+#include <string.h>
+#include <algorithm>
+#include <string>
+#include <vector>
+
+void (*dgs_fatal_report)(const char *, const char *) = nullptr;
+
+// Applying patch made from A to B turns A into B exactly, including wide scattered edits of large blocks.
+
+static std::string to_text(const DataBlock &blk) {
+  DynamicMemGeneralSaveCB cb(tmpmem);
+  blk.saveToTextStream(cb);
+  return std::string((const char *)cb.data(), cb.size());
+}
+
+static const char *name(int i) {
+  static char buf[16];
+  snprintf(buf, sizeof(buf), "n%d", i % 50);
+  return buf;
+}
+
+static void check_patch(const char *what, DataBlock &a, const DataBlock &b) {
+  danet::BitStream patch;
+  a.makePatch(b, patch);
+  std::vector<uint8_t> bytes(patch.GetData(), patch.GetData() + patch.GetNumberOfBytesUsed());
+  TEST_CHECK(a.applyPatch(patch), "%s: patch failed to apply", what);
+  TEST_CHECK(to_text(a) == to_text(b), "%s: patched tree differs from target", what);
+  TEST_CHECK(a.getContentHash() == b.getContentHash(), "%s: content hashes differ after patch", what);
+
+  // truncated patch is rejected (tree is left partially patched)
+  for (uint32_t len : {uint32_t(1), uint32_t(bytes.size() / 2), uint32_t(bytes.size() - 1)}) {
+    DataBlock c;
+    c.setFrom(&b);
+    danet::BitStream truncated(bytes.data(), len, false);
+    c.applyPatch(truncated);
+  }
+}
+
+// every third param removed, every seventh changed, new ones inserted after every fifth;
+// same for sub-blocks, kept ones get scattered edits of their own
+static void scattered_edit(const DataBlock &src, DataBlock &dst, int depth) {
+  for (int i = 0; i < src.paramCount(); ++i) {
+    if (i % 3 != 1)
+      dst.addInt(src.getParamName(i), i % 7 == 0 ? -src.getInt(i) : src.getInt(i));
+    if (i % 5 == 4)
+      dst.addInt(name(i + 17), 1000000 + i);
+  }
+  for (int i = 0; i < src.blockCount(); ++i) {
+    const DataBlock *sub = src.getBlock(i);
+    if (i % 3 != 1) {
+      DataBlock *copy = dst.addNewBlock(sub->getBlockName());
+      if (depth == 0 && i % 2)
+        scattered_edit(*sub, *copy, depth + 1);
+      else
+        copy->setFrom(sub);
+    }
+    if (i % 5 == 4)
+      dst.addNewBlock(name(i + 23))->addInt("new", i);
+  }
+}
+
+static void fill(DataBlock &blk, int params, int blocks, int sub_params) {
+  for (int i = 0; i < params; ++i)
+    blk.addInt(name(i), i);
+  for (int i = 0; i < blocks; ++i) {
+    DataBlock *sub = blk.addNewBlock(name(i));
+    for (int j = 0; j < sub_params; ++j)
+      sub->addInt(name(j), j);
+  }
+}
+
+int main() {
+  dagor_force_init_memmgr();
+
+  {
+    DataBlock a, b;
+    fill(a, 200000, 20000, 20);
+    scattered_edit(a, b, 0);
+    check_patch("scattered edits", a, b);
+  }
+
+  {
+    DataBlock a, b;
+    fill(a, 100000, 0, 0);
+    for (int i = 0; i < a.paramCount(); i += 2) // every other param removed
+      b.addInt(a.getParamName(i), a.getInt(i));
+    check_patch("every other removed", a, b);
+  }
+
+  {
+    DataBlock a, b;
+    fill(a, 100000, 0, 0);
+    std::vector<int> order(a.paramCount());
+    TestRng rng(30);
+    for (int i = 0; i < (int)order.size(); ++i)
+      order[i] = i;
+    for (int i = (int)order.size() - 1; i > 0; --i)
+      std::swap(order[i], order[rng.next32() % (i + 1)]);
+    for (int i : order)
+      b.addInt(a.getParamName(i), a.getInt(i));
+    check_patch("shuffled block", a, b);
+  }
+
+  {
+    DataBlock a, b;
+    fill(a, 1000, 100, 5);
+    check_patch("everything removed", a, b);
+    DataBlock c;
+    fill(b, 1000, 100, 5);
+    check_patch("everything inserted", c, b);
+  }
+
+  return test_result("datablockPatch");
+}
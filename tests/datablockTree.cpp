@@ -0,0 +1,248 @@
+#include "test.h"
+#include <datablock/datablock.h>
+#include <ioSys/dag_memIo.h>
+#include <memory/dag_mem.h>
+#include <memory/dag_memStat.h>
+#include <string.h>
+#include <algorithm>
+#include <string>
+#include <vector>
+
+void (*dgs_fatal_report)(const char *, const char *) = nullptr;
+
+// Content hash, diff paths, predicate removal and memory report agree with what the tree actually holds.
+
+static std::string to_text(const DataBlock &blk) {
+  DynamicMemGeneralSaveCB cb(tmpmem);
+  blk.saveToTextStream(cb);
+  return std::string((const char *)cb.data(), cb.size());
+}
+
+static void load(DataBlock &blk, const char *text) {
+  std::string copy(text);
+  TEST_CHECK(blk.loadText(copy.data(), int(copy.size())), "can't parse: %s", text);
+}
+
+// hash of freshly built copy, nothing cached
+static uint64_t fresh_hash(const DataBlock &blk) {
+  DataBlock copy;
+  load(copy, to_text(blk).c_str());
+  return copy.getContentHash();
+}
+
+static void check_hash() {
+  DataBlock blk;
+  load(blk, "a:i=1; s:t=\"str\";\n"
+            "x{ p:i=1; deep{ v:r=1.5; deeper{ w:t=\"leaf\"; } } }\n"
+            "y{ p:i=2; }\n");
+  uint64_t root = blk.getContentHash();
+  DataBlock *x = blk.getBlockByName("x");
+  DataBlock *deeper = x->getBlockByName("deep")->getBlockByName("deeper");
+  const DataBlock *y = blk.getBlockByName("y");
+  uint64_t xHash = x->getContentHash(), yHash = y->getContentHash();
+  TEST_CHECK(root == fresh_hash(blk), "hash differs from hash of the same contents");
+
+  // names are hashed by string: same contents in other name order (other name ids) give same hash
+  DataBlock other;
+  load(other, "zz:i=0;\n");
+  other.removeParam("zz");
+  other.setFrom(&blk);
+  TEST_CHECK(other.getContentHash() == root, "hash depends on NameMap");
+
+  deeper->setStr("w", "changed");
+  TEST_CHECK(blk.getContentHash() != root, "root hash kept after deep sub-block change");
+  TEST_CHECK(x->getContentHash() != xHash, "parent hash kept after deep sub-block change");
+  TEST_CHECK(y->getContentHash() == yHash, "sibling hash changed");
+  TEST_CHECK(blk.getContentHash() == fresh_hash(blk), "hash after deep change differs from hash of the same contents");
+  deeper->setStr("w", "leaf");
+  TEST_CHECK(blk.getContentHash() == root, "hash not restored with contents");
+  TEST_CHECK(x->getContentHash() == xHash, "parent hash not restored with contents");
+
+  deeper->addInt("n", 1);
+  TEST_CHECK(blk.getContentHash() != root, "root hash kept after param added deep");
+  deeper->removeParam("n");
+  TEST_CHECK(blk.getContentHash() == root, "hash not restored after added param removed");
+  x->getBlockByName("deep")->addNewBlock("added");
+  TEST_CHECK(blk.getContentHash() != root, "root hash kept after sub-block added deep");
+  x->getBlockByName("deep")->removeBlock("added");
+  TEST_CHECK(blk.getContentHash() == root, "hash not restored after added sub-block removed");
+
+  // own block name is not hashed, sub-block names are
+  TEST_CHECK(x->getContentHash() == blk.getBlockByName("x")->getContentHash(), "hash is not stable");
+  DataBlock renamed;
+  renamed.setFrom(&blk);
+  renamed.addNewBlock(renamed.getBlockByName("x"), "x2");
+  renamed.removeBlock("x");
+  TEST_CHECK(renamed.getBlockByName("x2")->getContentHash() == xHash, "hash includes own block name");
+  TEST_CHECK(renamed.getContentHash() != root, "hash does not include sub-block names");
+}
+
+struct DiffCollector : DataBlockDiffCB {
+  std::vector<std::string> items;
+
+  void add(const char *what, Kind kind, const char *path) {
+    static const char *kinds[] = {"added", "removed", "changed"};
+    items.push_back(std::string(kinds[kind]) + " " + what + " " + path);
+  }
+  void onParam(Kind kind, const char *path, const DataBlock *from, int from_idx, const DataBlock *to, int to_idx) override {
+    TEST_CHECK((from_idx >= 0) == (from != NULL) && (to_idx >= 0) == (to != NULL), "%s: inconsistent param refs", path);
+    TEST_CHECK(kind != CHANGED || (from && to), "%s: changed param is absent on one side", path);
+    add("param", kind, path);
+  }
+  void onBlock(Kind kind, const char *path, const DataBlock *from, const DataBlock *to) override {
+    TEST_CHECK((kind == ADDED) == (from == NULL) && (kind == REMOVED) == (to == NULL), "%s: wrong block refs", path);
+    // path of reported block is the one getBlockPath() gives
+    char buf[256];
+    (from ? from : to)->getBlockPath(buf, sizeof(buf));
+    TEST_CHECK(strcmp(buf, path) == 0, "diff path %s, block path %s", path, buf);
+    add("block", kind, path);
+  }
+};
+
+static void check_diff() {
+  DataBlock from, to;
+  load(from, "a:i=1; a:i=2; a:i=3; b:i=1;\n"
+             "x{ v:i=1; }\n"
+             "x{ v:i=2; v:i=3; }\n"
+             "x{ v:i=4; }\n"
+             "y{ x{} x{ w:i=1; } }\n");
+  load(to, "a:i=1; a:i=5; b:t=\"1\"; c:i=1; c:i=2;\n"
+           "x{ v:i=1; }\n"
+           "x{ v:i=2; v:i=7; }\n"
+           "y{ x{} x{ w:i=2; } x{} }\n"
+           "z{}\n");
+  DiffCollector cb;
+  from.diff(to, cb);
+  std::vector<std::string> expected = {
+    "changed param a[1]",
+    "removed param a[2]",
+    "changed param b",
+    "added param c",
+    "added param c[1]",
+    "removed block x[2]",
+    "added block z",
+    "changed param x[1]/v[1]",
+    "changed param y/x[1]/w",
+    "added block y/x[2]",
+  };
+  std::sort(cb.items.begin(), cb.items.end());
+  std::sort(expected.begin(), expected.end());
+  TEST_CHECK(cb.items == expected, "diff reported %d items, expected %d", int(cb.items.size()), int(expected.size()));
+  for (const std::string &item : cb.items)
+    TEST_CHECK(std::find(expected.begin(), expected.end(), item) != expected.end(), "unexpected diff item: %s", item.c_str());
+
+  DiffCollector same;
+  from.diff(from, same);
+  TEST_CHECK(same.items.empty(), "tree differs from itself");
+}
+
+static void check_remove_if() {
+  DataBlock blk;
+  load(blk, "a:i=0; b:i=1; a:i=2; c:t=\"3\"; a:i=4; b:i=5;\n"
+            "x{ k:i=0; } y{ k:i=1; } x{ k:i=2; } z{ k:i=3; } x{ k:i=4; }\n");
+  uint64_t hash = blk.getContentHash();
+
+  std::vector<int> called;
+  TEST_CHECK(blk.removeParamsIf([&](int i) {
+    called.push_back(i);
+    return false;
+  }) == 0, "params removed by false predicate");
+  TEST_CHECK(called == std::vector<int>({0, 1, 2, 3, 4, 5}), "predicate is not called once per param in order");
+  TEST_CHECK(blk.removeBlocksIf([](int) { return false; }) == 0, "blocks removed by false predicate");
+  TEST_CHECK(blk.getContentHash() == hash, "hash changed with nothing removed");
+
+  // predicate sees original numbering, kept items preserve order
+  called.clear();
+  TEST_CHECK(blk.removeParamsIf([&](int i) {
+    called.push_back(i);
+    return blk.getParamType(i) == DataBlock::TYPE_STRING || (i & 1) == 0;
+  }) == 4, "wrong number of params removed");
+  TEST_CHECK(called == std::vector<int>({0, 1, 2, 3, 4, 5}), "predicate is not called once per param in order");
+  TEST_CHECK(blk.getContentHash() != hash, "hash kept after params removed");
+  hash = blk.getContentHash();
+  TEST_CHECK(blk.removeBlocksIf([&](int i) { return blk.getBlock(i)->getInt("k", -1) % 2 == 0; }) == 3,
+    "wrong number of blocks removed");
+  TEST_CHECK(blk.getContentHash() != hash, "hash kept after blocks removed");
+
+  DataBlock expected;
+  load(expected, "b:i=1; b:i=5;\ny{ k:i=1; } z{ k:i=3; }\n");
+  TEST_CHECK(to_text(blk) == to_text(expected), "wrong items kept:\n%s", to_text(blk).c_str());
+  TEST_CHECK(blk.getContentHash() == expected.getContentHash(), "hash differs from hash of the same contents");
+
+  TEST_CHECK(blk.removeParamsIf([](int) { return true; }) == 2 && blk.paramCount() == 0, "not all params removed");
+  TEST_CHECK(blk.removeBlocksIf([](int) { return true; }) == 2 && blk.blockCount() == 0, "not all blocks removed");
+  TEST_CHECK(blk.getContentHash() == DataBlock().getContentHash(), "emptied block hash differs from empty one");
+}
+
+static void check_mem_usage() {
+  std::string big(4000, 'x');
+  size_t allocatedBefore = dagor_memory_stat::get_memory_allocated();
+  DataBlock *blk = new DataBlock;
+  char buf[64];
+  for (int i = 0; i < 10; ++i) {
+    DataBlock *sub = blk->addNewBlock("sub");
+    for (int j = 0; j < 5; ++j)
+      sub->addInt("i", j);
+    snprintf(buf, sizeof(buf), "string %d", i);
+    sub->addStr("s", buf);
+  }
+  DataBlock *heavy = blk->addNewBlock("sub")->addNewBlock("heavy");
+  heavy->addStr("big", big.c_str());
+  size_t allocated = dagor_memory_stat::get_memory_allocated() - allocatedBefore;
+
+  DataBlock::MemUsage u;
+  DataBlock::MemUsageTop top[4];
+  int n = blk->calcMemUsage(u, top, 4);
+  TEST_CHECK(u.blocks == 13 && u.params == 61 && u.strings == 11, "counted %d blocks, %d params, %d strings", u.blocks,
+    u.params, u.strings);
+  TEST_CHECK(u.stringBytes > big.size() && u.paramsUsed <= u.paramsReserved && u.blockPtrsUsed <= u.blockPtrsReserved,
+    "inconsistent usage");
+  TEST_CHECK(u.nodeBytes == 13 * sizeof(DataBlock) && u.nameMapBytes > 0, "nodes %zu, names %zu", u.nodeBytes, u.nameMapBytes);
+  // chunks of everything but root object itself, which is counted by size only (its chunk may be larger)
+  TEST_CHECK(u.heapBytes + sizeof(DataBlock) <= allocated + 64 && u.heapBytes + sizeof(DataBlock) + 1024 >= allocated,
+    "heap %zu bytes, allocated %zu", u.heapBytes, allocated);
+  TEST_CHECK(u.heapBytes >= u.usedBytes() - sizeof(DataBlock), "heap %zu bytes, used %zu", u.heapBytes, u.usedBytes());
+
+  TEST_CHECK(n == 4, "%d top blocks", n);
+  TEST_CHECK(top[0].blk == heavy && top[0].ownBytes > big.size() && top[0].subtreeBytes == top[0].ownBytes,
+    "heaviest block is not the one with big string");
+  for (int i = 1; i < n; ++i)
+    TEST_CHECK(top[i].ownBytes <= top[i - 1].ownBytes, "top is not sorted");
+  DataBlock::MemUsageTop all[16];
+  n = blk->calcMemUsage(u, all, 16);
+  TEST_CHECK(n == 13, "%d top blocks of 13", n);
+  for (int i = 0; i < n; ++i)
+    if (all[i].blk == blk) {
+      size_t own = 0;
+      for (int j = 0; j < n; ++j)
+        own += all[j].ownBytes;
+      TEST_CHECK(all[i].subtreeBytes == own, "root subtree %zu bytes, sum of own %zu", all[i].subtreeBytes, own);
+    }
+  TEST_CHECK(blk->calcMemUsage(u) == 0, "top filled without array");
+
+  // arrays are grown geometrically, shrink_to_fit() may keep some capacity if allocator can't shrink in place
+  size_t wasted = u.wastedBytes();
+  TEST_CHECK(wasted > 0, "no capacity reserved by add*()");
+  blk->shrink();
+  blk->calcMemUsage(u);
+  TEST_CHECK(u.wastedBytes() < wasted, "%zu bytes wasted after shrink(), %zu before", u.wastedBytes(), wasted);
+  TEST_CHECK(blk->relocate(), "relocate failed");
+  DataBlock::MemUsage r;
+  blk->calcMemUsage(r);
+  TEST_CHECK(r.blocks == u.blocks && r.params == u.params && r.stringBytes == u.stringBytes,
+    "relocated tree counted differently");
+  TEST_CHECK(r.heapChunks < u.heapChunks, "relocated: %d chunks, was %d chunks", r.heapChunks, u.heapChunks);
+  blk->dumpMemUsage(5);
+  delete blk;
+}
+
+int main() {
+  dagor_force_init_memmgr();
+
+  check_hash();
+  check_diff();
+  check_remove_if();
+  check_mem_usage();
+
+  return test_result("datablockTree");
+}
@@ -0,0 +1,42 @@
+#pragma once
+
+#include <stdint.h>
+#include <stdio.h>
+
+// Minimal checks for test executables: failures are reported and counted, main() returns test_result().
+inline int &test_failures() {
+  static int failures = 0;
+  return failures;
+}
+
+#define TEST_CHECK(cond, ...)                                       \
+  do {                                                              \
+    if (!(cond) && test_failures()++ < 20) {                        \
+      fprintf(stderr, "%s:%d: check failed: ", __FILE__, __LINE__); \
+      fprintf(stderr, __VA_ARGS__);                                 \
+      fputc('\n', stderr);                                          \
+    }                                                               \
+  } while (0)
+
+inline int test_result(const char *name) {
+  if (test_failures())
+    fprintf(stderr, "%s: %d checks failed\n", name, test_failures());
+  else
+    fprintf(stderr, "%s: ok\n", name);
+  return test_failures() ? 1 : 0;
+}
+
+// Fixed-seed xorshift, so every run checks the same inputs.
+struct TestRng {
+  uint64_t state;
+
+  explicit TestRng(uint64_t seed) : state(seed * 0x9E3779B97F4A7C15ull + 1) {}
+  uint64_t next() {
+    state ^= state << 13;
+    state ^= state >> 7;
+    state ^= state << 17;
+    return state;
+  }
+  uint32_t next32() { return uint32_t(next() >> 32); }
+  float uniform(float lo, float hi) { return lo + (hi - lo) * float(next32() >> 8) / float(1 << 24); }
+};
@@ -4,10 +4,16 @@
 
 #include <bitstream/bitstream.h>
 #include <datablock/datablock.h>
+#include <ioSys/dag_genIo.h>
+#include <ioSys/dag_memIo.h>
 #include <memory/dag_mem.h>
 
 using namespace emscripten;
 
+static void append_to_std_string(void *ctx, const void *ptr, int size) {
+  ((std::string *)ctx)->append((const char *)ptr, size);
+}
+
 EMSCRIPTEN_BINDINGS(dagutils) {
   class_<danet::BitStream>("BitStream")
       .constructor<>()
@@ -201,4 +207,28 @@ EMSCRIPTEN_BINDINGS(dagutils) {
                     return val(v);
                   return val::null();
                 }));
+
+  class_<DataBlock>("DataBlock")
+      .constructor<>()
+      .function("paramCount", &DataBlock::paramCount)
+      .function("blockCount", &DataBlock::blockCount)
+      .function("loadText", optional_override([](DataBlock &self,
+                                                 const std::string &text) {
+                  return self.loadText((char *)text.data(), (int)text.length());
+                }))
+      .function("saveToText",
+                optional_override([](const DataBlock &self) -> std::string {
+                  std::string out;
+                  CallbackGeneralSaveCB cwr(&append_to_std_string, &out);
+                  self.saveToTextStream(cwr);
+                  return out;
+                }))
+      .function("saveToTextBytes",
+                optional_override([](const DataBlock &self) -> val {
+                  DynamicMemGeneralSaveCB cwr;
+                  self.saveToTextStream(cwr);
+                  return val::global("Uint8Array")
+                      .new_(typed_memory_view(cwr.size(),
+                                              (const uint8_t *)cwr.data()));
+                }));
 }